@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdio>
+#include <random>
+#include <SFML/System/Clock.hpp>
+#include "socket_transport.hpp"
+#include "subdomain_solver.hpp"
+
+
+namespace dd
+{
+
+struct ScalingBenchmarkSettings
+{
+    IVec2    world_size          = {2000, 200};
+    uint32_t object_count        = 100000;
+    uint32_t frame_count         = 120;
+    uint32_t max_process_count   = 8;
+    uint32_t threads_per_process = 1;
+};
+
+
+// Same problem solved by 1 to max_process_count local processes, each one owning a slice of the world
+inline void runScalingBenchmark(const ScalingBenchmarkSettings& settings)
+{
+#ifndef _WIN32
+    printf("Strong scaling, %u objects in a %dx%d world, %u frames, %u thread(s) per process\n",
+           settings.object_count, settings.world_size.x, settings.world_size.y, settings.frame_count, settings.threads_per_process);
+    float reference_time = 0.0f;
+    for (uint32_t process_count{1}; process_count <= settings.max_process_count; ++process_count) {
+        std::vector<std::vector<double>> results;
+        const bool success = runLocalProcesses(process_count, [&settings](Transport& transport, std::vector<double>& result) {
+            tp::ThreadPool  thread_pool(settings.threads_per_process);
+            SubDomainSolver solver{settings.world_size, thread_pool, transport};
+            solver.gravity = {0.0f, 0.0f};
+            // Every rank draws the same objects and keeps its own
+            std::mt19937 gen(0x13b);
+            std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+            for (uint32_t i{settings.object_count}; i--;) {
+                const Vec2 position{2.0f + dis(gen) * to<float>(settings.world_size.x - 4),
+                                    2.0f + dis(gen) * to<float>(settings.world_size.y - 4)};
+                const Vec2 velocity{0.2f * (dis(gen) - 0.5f), 0.2f * (dis(gen) - 0.5f)};
+                if (solver.owns(position)) {
+                    solver.objects[solver.createWorldObject(position)].addVelocity(velocity);
+                }
+            }
+            sf::Clock clock;
+            for (uint32_t i{settings.frame_count}; i--;) {
+                if (!solver.step(1.0f / 60.0f)) {
+                    // Ranks end with _exit, stdout would not be flushed
+                    fprintf(stderr, "Rank %u lost a neighbour, stopping\n", transport.getRank());
+                    return false;
+                }
+            }
+            result = {clock.getElapsedTime().asSeconds(), to<double>(solver.owned_count)};
+            return true;
+        }, results);
+        if (!success) {
+            printf("%u process(es): run failed, benchmark aborted\n", process_count);
+            return;
+        }
+
+        float    time          = 0.0f;
+        uint64_t objects_count = 0;
+        for (const std::vector<double>& result : results) {
+            if (result.size() == 2) {
+                time           = std::max(time, to<float>(result[0]));
+                objects_count += to<uint64_t>(result[1]);
+            }
+        }
+        if (process_count == 1) {
+            reference_time = time;
+        }
+        const float speedup = reference_time / time;
+        printf("%u process(es): %.3f s, speedup %.2f, efficiency %.0f%%, objects %lu\n",
+               process_count, time, speedup, 100.0f * speedup / to<float>(process_count), static_cast<unsigned long>(objects_count));
+    }
+#else
+    (void)settings;
+    printf("Domain decomposition needs Unix sockets, the scaling benchmark is not available on this platform\n");
+#endif
+}
+
+}
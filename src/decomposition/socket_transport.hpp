@@ -0,0 +1,210 @@
+#pragma once
+#include <functional>
+#include "transport.hpp"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+namespace dd
+{
+
+#ifndef _WIN32
+
+// Transport between processes of the same machine, every pair of ranks shares a Unix socket
+struct SocketTransport : public Transport
+{
+    uint32_t         rank;
+    std::vector<int> sockets;
+
+    // sockets[peer] is the local end of the connection to peer
+    SocketTransport(uint32_t rank_, std::vector<int> sockets_)
+        : rank{rank_}
+        , sockets{std::move(sockets_)}
+    {}
+
+    ~SocketTransport() override
+    {
+        for (const int fd : sockets) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    [[nodiscard]]
+    uint32_t getRank() const override
+    {
+        return rank;
+    }
+
+    [[nodiscard]]
+    uint32_t getRankCount() const override
+    {
+        return static_cast<uint32_t>(sockets.size());
+    }
+
+    [[nodiscard]]
+    bool send(uint32_t peer, const std::vector<uint8_t>& message) override
+    {
+        const uint64_t size = message.size();
+        return writeAll(sockets[peer], &size, sizeof(size)) && writeAll(sockets[peer], message.data(), size);
+    }
+
+    [[nodiscard]]
+    bool receive(uint32_t peer, std::vector<uint8_t>& message) override
+    {
+        uint64_t size = 0;
+        if (!readAll(sockets[peer], &size, sizeof(size))) {
+            message.clear();
+            return false;
+        }
+        message.resize(size);
+        return readAll(sockets[peer], message.data(), size);
+    }
+
+    static bool writeAll(int fd, const void* data, uint64_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        while (size) {
+            const ssize_t written = write(fd, bytes, size);
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            size  -= static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, void* data, uint64_t size)
+    {
+        auto* bytes = static_cast<uint8_t*>(data);
+        while (size) {
+            const ssize_t received = read(fd, bytes, size);
+            if (received <= 0) {
+                return false;
+            }
+            bytes += received;
+            size  -= static_cast<uint64_t>(received);
+        }
+        return true;
+    }
+};
+
+
+/* Forks one process per rank, connected by a SocketTransport, and runs job in each of them.
+   The values given by each rank are sent back to the calling process through a pipe. Returns false if a rank
+   could not be started, or if any of them failed: a rank losing a neighbour can't go on, the whole run is lost.
+   Has to be called before any thread is started since the process is forked */
+inline bool runLocalProcesses(uint32_t count, const std::function<bool(Transport&, std::vector<double>&)>& job,
+                              std::vector<std::vector<double>>& results)
+{
+    std::vector<std::vector<int>> sockets(count, std::vector<int>(count, -1));
+    std::vector<int>              result_pipes(count, -1);
+    std::vector<pid_t>            children(count, -1);
+    const auto close_all = [&]() {
+        for (std::vector<int>& row : sockets) {
+            for (int& fd : row) {
+                if (fd >= 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+        }
+    };
+
+    bool success = true;
+    for (uint32_t i{0}; i < count && success; ++i) {
+        for (uint32_t j{i + 1}; j < count && success; ++j) {
+            int pair[2];
+            success = socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0;
+            if (success) {
+                sockets[i][j] = pair[0];
+                sockets[j][i] = pair[1];
+            }
+        }
+    }
+
+    for (uint32_t rank{0}; rank < count && success; ++rank) {
+        int result_pipe[2];
+        if (pipe(result_pipe) != 0) {
+            success = false;
+            break;
+        }
+        const pid_t pid = fork();
+        if (pid < 0) {
+            close(result_pipe[0]);
+            close(result_pipe[1]);
+            success = false;
+            break;
+        }
+        if (pid == 0) {
+            // A peer that died makes writes fail instead of killing this rank
+            signal(SIGPIPE, SIG_IGN);
+            // Only keep this rank's ends of the sockets
+            close(result_pipe[0]);
+            for (uint32_t i{0}; i < count; ++i) {
+                for (uint32_t j{0}; j < count; ++j) {
+                    if (i != rank && sockets[i][j] >= 0) {
+                        close(sockets[i][j]);
+                    }
+                }
+                if (result_pipes[i] >= 0) {
+                    close(result_pipes[i]);
+                }
+            }
+            std::vector<double> result;
+            bool                job_success;
+            {
+                SocketTransport transport{rank, sockets[rank]};
+                job_success = job(transport, result);
+            }
+            const uint64_t size = result.size();
+            job_success = job_success && SocketTransport::writeAll(result_pipe[1], &size, sizeof(size)) &&
+                          SocketTransport::writeAll(result_pipe[1], result.data(), size * sizeof(double));
+            close(result_pipe[1]);
+            _exit(job_success ? 0 : 1);
+        }
+        close(result_pipe[1]);
+        result_pipes[rank] = result_pipe[0];
+        children[rank]     = pid;
+    }
+
+    // Ranks already started would wait forever on the missing ones
+    if (!success) {
+        for (const pid_t pid : children) {
+            if (pid > 0) {
+                kill(pid, SIGKILL);
+            }
+        }
+    }
+    close_all();
+
+    results.assign(count, {});
+    for (uint32_t rank{0}; rank < count; ++rank) {
+        if (result_pipes[rank] >= 0) {
+            uint64_t size = 0;
+            if (success && SocketTransport::readAll(result_pipes[rank], &size, sizeof(size))) {
+                results[rank].resize(size);
+                success = SocketTransport::readAll(result_pipes[rank], results[rank].data(), size * sizeof(double));
+            } else {
+                success = false;
+            }
+            close(result_pipes[rank]);
+        }
+        if (children[rank] > 0) {
+            int status = 0;
+            success = waitpid(children[rank], &status, 0) == children[rank] && WIFEXITED(status) && WEXITSTATUS(status) == 0 && success;
+        }
+    }
+    return success;
+}
+
+#endif
+
+}
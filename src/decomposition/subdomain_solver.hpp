@@ -0,0 +1,270 @@
+#pragma once
+#include <array>
+#include <cstring>
+#include "physics/physics.hpp"
+#include "transport.hpp"
+
+
+namespace dd
+{
+
+// Object as exchanged between sub domains, in world coordinates
+struct ParticleRecord
+{
+    Vec2      position;
+    Vec2      last_position;
+    sf::Color color;
+};
+
+
+/* Solver owning the vertical slice [x_min, x_max) of the world, the slice of each rank is set by the transport.
+   Every sub step, objects leaving the slice migrate to the neighbour and objects close to the slice borders
+   are sent as ghosts, taking part in the collisions of the neighbour without being integrated by it */
+struct SubDomainSolver : public PhysicSolver
+{
+    // Cells around the owned range, they hold ghosts and objects about to migrate
+    static constexpr int32_t halo_cells  = 3;
+    // Contact range
+    static constexpr float   ghost_width = 1.0f;
+
+    enum Side
+    {
+        Left  = 0,
+        Right = 1,
+    };
+
+    // Records produced by one batch of the outgoing objects scan
+    struct Outgoing
+    {
+        std::array<std::vector<ParticleRecord>, 2> migrants;
+        std::array<std::vector<ParticleRecord>, 2> ghosts;
+        std::vector<uint32_t>                      migrant_indices;
+    };
+
+    Transport& transport;
+    Vec2       global_size;
+    // Owned range in world coordinates
+    float      x_min;
+    float      x_max;
+    // World x of the local x = 0
+    float      origin;
+    // Owned objects come first, ghosts are appended after them during collisions
+    uint64_t   owned_count = 0;
+
+    std::vector<Outgoing>                  outgoing;
+    std::array<std::vector<uint8_t>, 2>    messages_out;
+    std::array<std::vector<uint8_t>, 2>    messages_in;
+
+    SubDomainSolver(IVec2 world_size, tp::ThreadPool& tp, Transport& transport_)
+        : PhysicSolver(getLocalSize(world_size, transport_), tp)
+        , transport{transport_}
+        , global_size{to<float>(world_size.x), to<float>(world_size.y)}
+        , x_min{to<float>(getSliceStart(world_size.x, transport_.getRank(), transport_.getRankCount()))}
+        , x_max{to<float>(getSliceStart(world_size.x, transport_.getRank() + 1, transport_.getRankCount()))}
+        , origin{x_min - to<float>(halo_cells)}
+    {
+    }
+
+    static int32_t getSliceStart(int32_t world_width, uint32_t rank, uint32_t rank_count)
+    {
+        return to<int32_t>(to<int64_t>(world_width) * rank / rank_count);
+    }
+
+    static IVec2 getLocalSize(IVec2 world_size, const Transport& transport)
+    {
+        const uint32_t rank  = transport.getRank();
+        const uint32_t count = transport.getRankCount();
+        const int32_t  width = getSliceStart(world_size.x, rank + 1, count) - getSliceStart(world_size.x, rank, count);
+        return {width + 2 * halo_cells, world_size.y};
+    }
+
+    [[nodiscard]]
+    bool hasNeighbour(Side side) const
+    {
+        return side == Left ? transport.getRank() > 0 : transport.getRank() + 1 < transport.getRankCount();
+    }
+
+    [[nodiscard]]
+    bool owns(Vec2 world_position) const
+    {
+        return world_position.x >= x_min && world_position.x < x_max;
+    }
+
+    // Adds an owned object, the position is in world coordinates
+    uint64_t createWorldObject(Vec2 world_position)
+    {
+        const uint64_t id = createObject(world_position - Vec2{origin, 0.0f});
+        owned_count = objects.size();
+        return id;
+    }
+
+    // Replaces PhysicSolver::update, neighbours are synchronized once per sub step. Returns false if a neighbour was lost or sent a malformed message
+    [[nodiscard]]
+    bool step(float dt)
+    {
+        const float sub_dt = dt / static_cast<float>(sub_steps);
+        for (uint32_t i(sub_steps); i--;) {
+            if (!exchangeObjects()) {
+                return false;
+            }
+            addObjectsToGrid();
+            solveCollisions();
+            removeGhosts();
+            updateObjects_multi(sub_dt);
+        }
+        return true;
+    }
+
+    [[nodiscard]]
+    bool exchangeObjects()
+    {
+        collectOutgoing();
+        for (const Side side : {Left, Right}) {
+            writeMessage(side);
+        }
+        // Even ranks talk to their right neighbour first and odd ranks to their left one, pairs never wait on each other
+        const bool even = transport.getRank() % 2 == 0;
+        for (const Side side : {even ? Right : Left, even ? Left : Right}) {
+            messages_in[side].clear();
+            if (hasNeighbour(side)) {
+                const uint32_t peer = side == Left ? transport.getRank() - 1 : transport.getRank() + 1;
+                if (!transport.exchange(peer, messages_out[side], messages_in[side]) || !isValidMessage(messages_in[side])) {
+                    return false;
+                }
+            }
+        }
+        // Migrants become owned objects, ghosts go after all of them
+        for (const Side side : {Left, Right}) {
+            readMessage(messages_in[side], true);
+        }
+        owned_count = objects.size();
+        for (const Side side : {Left, Right}) {
+            readMessage(messages_in[side], false);
+        }
+        return true;
+    }
+
+    void removeGhosts()
+    {
+        // Erasing the last object does not move any other one
+        while (objects.size() > owned_count) {
+            objects.erase(objects.getID(objects.size() - 1));
+        }
+    }
+
+    // Walls only exist at the world borders, slices borders are crossed freely
+    void updateObjects_multi(float dt) override
+    {
+        const float margin      = 2.0f;
+        const float local_width = to<float>(grid.width);
+        const float left_wall   = hasNeighbour(Left)  ? -local_width     : margin - origin;
+        const float right_wall  = hasNeighbour(Right) ? 2.0f * local_width : global_size.x - margin - origin;
+        thread_pool.dispatch(to<uint32_t>(objects.size()), [&](uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                PhysicObject& obj = objects.data[i];
+                // Add gravity and apply Verlet integration
+                obj.update(dt, gravity);
+                obj.position.x = Math::clamp(obj.position.x, left_wall, right_wall);
+                obj.position.y = Math::clamp(obj.position.y, margin, global_size.y - margin);
+            }
+        });
+    }
+
+private:
+    void collectOutgoing()
+    {
+        outgoing.resize(thread_pool.getBatchCount());
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch, uint32_t start, uint32_t end){
+            Outgoing& out = outgoing[batch];
+            for (const Side side : {Left, Right}) {
+                out.migrants[side].clear();
+                out.ghosts[side].clear();
+            }
+            out.migrant_indices.clear();
+            for (uint32_t i{start}; i < end; ++i) {
+                const PhysicObject&  obj = objects.data[i];
+                const ParticleRecord record{obj.position + Vec2{origin, 0.0f}, obj.last_position + Vec2{origin, 0.0f}, obj.getColor()};
+                const float          x = record.position.x;
+                if (x < x_min && hasNeighbour(Left)) {
+                    out.migrants[Left].push_back(record);
+                    out.migrant_indices.push_back(i);
+                } else if (x >= x_max && hasNeighbour(Right)) {
+                    out.migrants[Right].push_back(record);
+                    out.migrant_indices.push_back(i);
+                } else {
+                    if (x < x_min + ghost_width && hasNeighbour(Left)) {
+                        out.ghosts[Left].push_back(record);
+                    }
+                    if (x >= x_max - ghost_width && hasNeighbour(Right)) {
+                        out.ghosts[Right].push_back(record);
+                    }
+                }
+            }
+        });
+        // Batches cover increasing ranges, erasing from the highest index only swaps in objects that are kept
+        for (auto batch = outgoing.rbegin(); batch != outgoing.rend(); ++batch) {
+            for (auto i = batch->migrant_indices.rbegin(); i != batch->migrant_indices.rend(); ++i) {
+                objects.erase(objects.getID(*i));
+            }
+        }
+        owned_count = objects.size();
+    }
+
+    // Layout: migrants count, ghosts count, migrants, ghosts
+    void writeMessage(Side side)
+    {
+        uint32_t migrant_count = 0;
+        uint32_t ghost_count   = 0;
+        for (const Outgoing& out : outgoing) {
+            migrant_count += to<uint32_t>(out.migrants[side].size());
+            ghost_count   += to<uint32_t>(out.ghosts[side].size());
+        }
+        std::vector<uint8_t>& message = messages_out[side];
+        message.resize(2 * sizeof(uint32_t) + (migrant_count + ghost_count) * sizeof(ParticleRecord));
+        uint8_t* cursor = message.data();
+        const auto write = [&cursor](const void* data, uint64_t size) {
+            std::memcpy(cursor, data, size);
+            cursor += size;
+        };
+        write(&migrant_count, sizeof(migrant_count));
+        write(&ghost_count, sizeof(ghost_count));
+        for (const Outgoing& out : outgoing) {
+            write(out.migrants[side].data(), out.migrants[side].size() * sizeof(ParticleRecord));
+        }
+        for (const Outgoing& out : outgoing) {
+            write(out.ghosts[side].data(), out.ghosts[side].size() * sizeof(ParticleRecord));
+        }
+    }
+
+    // Counts come from the neighbour, their records have to fill the rest of the message exactly
+    static bool isValidMessage(const std::vector<uint8_t>& message)
+    {
+        uint32_t counts[2];
+        if (message.size() < sizeof(counts)) {
+            return false;
+        }
+        std::memcpy(counts, message.data(), sizeof(counts));
+        return message.size() == sizeof(counts) + (static_cast<uint64_t>(counts[0]) + counts[1]) * sizeof(ParticleRecord);
+    }
+
+    // Messages are empty on sides without neighbour, the others have been validated
+    void readMessage(const std::vector<uint8_t>& message, bool migrants)
+    {
+        if (message.empty()) {
+            return;
+        }
+        uint32_t counts[2];
+        std::memcpy(counts, message.data(), sizeof(counts));
+        const uint8_t* records = message.data() + sizeof(counts) + (migrants ? 0 : counts[0] * sizeof(ParticleRecord));
+        const uint32_t count   = migrants ? counts[0] : counts[1];
+        for (uint32_t i{0}; i < count; ++i) {
+            ParticleRecord record;
+            std::memcpy(&record, records + i * sizeof(ParticleRecord), sizeof(ParticleRecord));
+            PhysicObject& obj = objects[createObject(record.position - Vec2{origin, 0.0f})];
+            obj.last_position = record.last_position - Vec2{origin, 0.0f};
+            obj.setColor(record.color);
+        }
+    }
+};
+
+}
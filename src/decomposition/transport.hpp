@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+namespace dd
+{
+
+// Message passing between the processes of a decomposition, implementations can be swapped to go across nodes
+struct Transport
+{
+    virtual ~Transport() = default;
+
+    [[nodiscard]]
+    virtual uint32_t getRank() const = 0;
+
+    [[nodiscard]]
+    virtual uint32_t getRankCount() const = 0;
+
+    // Returns false when the peer can't be reached anymore
+    [[nodiscard]]
+    virtual bool send(uint32_t peer, const std::vector<uint8_t>& message) = 0;
+
+    // Blocks until a whole message from peer is available, returns false if the connection was lost before
+    [[nodiscard]]
+    virtual bool receive(uint32_t peer, std::vector<uint8_t>& message) = 0;
+
+    // The lower rank sends first, so both sides can never be blocked writing into full buffers
+    [[nodiscard]]
+    bool exchange(uint32_t peer, const std::vector<uint8_t>& message_out, std::vector<uint8_t>& message_in)
+    {
+        if (getRank() < peer) {
+            return send(peer, message_out) && receive(peer, message_in);
+        }
+        return receive(peer, message_in) && send(peer, message_out);
+    }
+};
+
+}
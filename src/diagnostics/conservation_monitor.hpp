@@ -0,0 +1,85 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include "physics/physics.hpp"
+
+
+/* Compares the solver conservation totals to reference ones and raises alarms when they drift too far.
+   Drifts are relative to the reference, a limit of 0 disables the corresponding alarm.
+   Open geometries exchange objects with the outside, only leaks and blow ups are watched by default */
+struct ConservationMonitor
+{
+    // Kinetic energy per object, it does not depend on the inflow and outflow balance
+    float    max_energy_drift   = 1.0f;
+    // Relative to the momentum scale sqrt(2 * energy * count) of the reference
+    float    max_momentum_drift = 0.0f;
+    float    max_count_drift    = 0.0f;
+    // Objects found outside of the geometry during one update
+    uint64_t max_leaked         = 0;
+
+    bool               has_reference = false;
+    ConservationTotals reference;
+    // Alarms raised by the last check, and since the monitor was created
+    uint32_t           alarms       = 0;
+    uint64_t           total_alarms = 0;
+
+    void setReference(const ConservationTotals& totals)
+    {
+        reference     = totals;
+        has_reference = true;
+    }
+
+    // To be called after each solver update, the first totals checked become the reference
+    bool check(const ConservationTotals& totals)
+    {
+        alarms = 0;
+        if (!has_reference) {
+            setReference(totals);
+            return false;
+        }
+        const double energy_drift = getDrift(getMeanEnergy(totals), getMeanEnergy(reference));
+        if (max_energy_drift > 0.0f && energy_drift > max_energy_drift) {
+            raise("mean kinetic energy", energy_drift);
+        }
+        const double momentum_scale = std::sqrt(2.0 * reference.kinetic_energy * to<double>(reference.count));
+        const double momentum_drift = std::hypot(totals.momentum_x - reference.momentum_x, totals.momentum_y - reference.momentum_y)
+                                    / std::max(momentum_scale, 1.0);
+        if (max_momentum_drift > 0.0f && momentum_drift > max_momentum_drift) {
+            raise("momentum", momentum_drift);
+        }
+        const double count_drift = getDrift(to<double>(totals.count), to<double>(reference.count));
+        if (max_count_drift > 0.0f && count_drift > max_count_drift) {
+            raise("objects count", count_drift);
+        }
+        if (totals.leaked > max_leaked) {
+            ++alarms;
+            printf("Conservation alarm: %lu object(s) leaked out of the geometry\n", static_cast<unsigned long>(totals.leaked));
+        }
+        total_alarms += alarms;
+        return alarms > 0;
+    }
+
+    static double getMeanEnergy(const ConservationTotals& totals)
+    {
+        return totals.count ? totals.kinetic_energy / to<double>(totals.count) : 0.0;
+    }
+
+    static double getDrift(double value, double reference_value)
+    {
+        return std::abs(value - reference_value) / std::max(std::abs(reference_value), 1.0);
+    }
+
+    static void print(const ConservationTotals& totals)
+    {
+        printf("objects: %lu, kinetic energy: %g, momentum: %g %g, leaked: %lu, outflow: %lu\n",
+               static_cast<unsigned long>(totals.count), totals.kinetic_energy, totals.momentum_x, totals.momentum_y,
+               static_cast<unsigned long>(totals.leaked), static_cast<unsigned long>(totals.outflow));
+    }
+
+private:
+    void raise(const char* quantity, double drift)
+    {
+        ++alarms;
+        printf("Conservation alarm: %s drifted by %.1f%%\n", quantity, 100.0 * drift);
+    }
+};
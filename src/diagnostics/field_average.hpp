@@ -0,0 +1,114 @@
+#pragma once
+#include "field_sampler.hpp"
+
+
+/* Cumulative and rolling time averages of a field stored as a flat array, no history is kept.
+   The rolling average is exponential with a time constant of window samples, it matches the
+   cumulative one until window samples have been added */
+template<typename T>
+struct FieldAverage
+{
+    uint32_t       window;
+    uint64_t       sample_count = 0;
+    std::vector<T> cumulative;
+    std::vector<T> rolling;
+
+    FieldAverage(uint32_t cell_count, uint32_t window_)
+        : window{window_}
+        , cumulative(cell_count, T{})
+        , rolling(cell_count, T{})
+    {}
+
+    void addSample(const std::vector<T>& values, tp::ThreadPool& thread_pool)
+    {
+        ++sample_count;
+        // Running means stay accurate in single precision whatever the samples count
+        const float cumulative_weight = 1.0f / to<float>(sample_count);
+        const float rolling_weight    = std::max(cumulative_weight, 1.0f / to<float>(window));
+        thread_pool.dispatch(to<uint32_t>(values.size()), [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                cumulative[i] += (values[i] - cumulative[i]) * cumulative_weight;
+                rolling[i]    += (values[i] - rolling[i]) * rolling_weight;
+            }
+        });
+    }
+
+    void reset()
+    {
+        sample_count = 0;
+        std::fill(cumulative.begin(), cumulative.end(), T{});
+        std::fill(rolling.begin(), rolling.end(), T{});
+    }
+};
+
+
+/* Time averaged fields of a FieldSampler. Averaging velocity or temperature samples directly would
+   weight a cell holding one object like a full one, so the moments are averaged and the fields derived from them */
+struct FieldStatistics
+{
+    // Number density, momentum density and kinetic energy density, twice the actual energy
+    FieldAverage<float> density;
+    FieldAverage<Vec2>  momentum;
+    FieldAverage<float> energy;
+
+    // Moments of the last sample
+    std::vector<Vec2>   momentum_sample;
+    std::vector<float>  energy_sample;
+
+    FieldStatistics(const FieldSampler& sampler, uint32_t window = 60)
+        : density{sampler.getCellCount(), window}
+        , momentum{sampler.getCellCount(), window}
+        , energy{sampler.getCellCount(), window}
+        , momentum_sample(sampler.getCellCount())
+        , energy_sample(sampler.getCellCount())
+    {}
+
+    // To be called after each sample of the sampler
+    void addSample(const FieldSampler& sampler, tp::ThreadPool& thread_pool)
+    {
+        thread_pool.dispatch(sampler.getCellCount(), [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                const Vec2 u = sampler.velocity[i];
+                momentum_sample[i] = u * sampler.density[i];
+                energy_sample[i]   = (2.0f * sampler.temperature[i] + MathVec2::length2(u)) * sampler.density[i];
+            }
+        });
+        density.addSample(sampler.density, thread_pool);
+        momentum.addSample(momentum_sample, thread_pool);
+        energy.addSample(energy_sample, thread_pool);
+    }
+
+    void reset()
+    {
+        density.reset();
+        momentum.reset();
+        energy.reset();
+    }
+
+    [[nodiscard]]
+    float getDensity(uint32_t i, bool rolling) const
+    {
+        return rolling ? density.rolling[i] : density.cumulative[i];
+    }
+
+    [[nodiscard]]
+    Vec2 getVelocity(uint32_t i, bool rolling) const
+    {
+        const float n = getDensity(i, rolling);
+        if (n <= 0.0f) {
+            return {0.0f, 0.0f};
+        }
+        return (rolling ? momentum.rolling[i] : momentum.cumulative[i]) / n;
+    }
+
+    [[nodiscard]]
+    float getTemperature(uint32_t i, bool rolling) const
+    {
+        const float n = getDensity(i, rolling);
+        if (n <= 0.0f) {
+            return 0.0f;
+        }
+        const float e = rolling ? energy.rolling[i] : energy.cumulative[i];
+        return std::max(0.0f, 0.5f * (e / n - MathVec2::length2(getVelocity(i, rolling))));
+    }
+};
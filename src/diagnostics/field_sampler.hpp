@@ -0,0 +1,141 @@
+#pragma once
+#include <SFML/System/Clock.hpp>
+#include "physics/physics.hpp"
+
+
+/* Macroscopic fields over a coarse grid of sampling cells: number density, mean velocity and kinetic temperature.
+   Velocities are in world units per second and the temperature follows the InflowEmitter convention,
+   unit mass and one degree of freedom per axis */
+struct FieldSampler
+{
+    IVec2    size;
+    // Side of a sampling cell in world units
+    float    cell_size;
+    // A sample is taken every interval calls to update
+    uint32_t interval;
+    uint32_t calls_count  = 0;
+    uint64_t sample_count = 0;
+    // Duration of the last sample, in milliseconds
+    float    last_sample_time = 0.0f;
+
+    // Fields of the last sample, indexed like getCellIndex
+    std::vector<float> density;
+    std::vector<Vec2>  velocity;
+    std::vector<float> temperature;
+
+    // Sums gathered by one batch of objects, zeroed again when merged
+    struct PartialSums
+    {
+        std::vector<float> count;
+        std::vector<Vec2>  momentum;
+        std::vector<float> energy;
+    };
+    std::vector<PartialSums> partials;
+
+    FieldSampler(Vec2 world_size, float cell_size_, uint32_t interval_ = 30)
+        : size{to<int32_t>(std::ceil(world_size.x / cell_size_)), to<int32_t>(std::ceil(world_size.y / cell_size_))}
+        , cell_size{cell_size_}
+        , interval{interval_}
+        , density(getCellCount(), 0.0f)
+        , velocity(getCellCount(), {0.0f, 0.0f})
+        , temperature(getCellCount(), 0.0f)
+    {}
+
+    [[nodiscard]]
+    uint32_t getCellCount() const
+    {
+        return to<uint32_t>(size.x * size.y);
+    }
+
+    [[nodiscard]]
+    uint32_t getCellIndex(int32_t x, int32_t y) const
+    {
+        return to<uint32_t>(x * size.y + y);
+    }
+
+    // Returns false for positions outside of the sampled area
+    bool getCellIndex(Vec2 position, uint32_t& index) const
+    {
+        const auto x = to<int32_t>(std::floor(position.x / cell_size));
+        const auto y = to<int32_t>(std::floor(position.y / cell_size));
+        if (x < 0 || y < 0 || x >= size.x || y >= size.y) {
+            return false;
+        }
+        index = getCellIndex(x, y);
+        return true;
+    }
+
+    // To be called once per frame after the solver update, returns true if a sample was taken
+    bool update(const PhysicSolver& solver, float dt)
+    {
+        if (++calls_count < interval) {
+            return false;
+        }
+        calls_count = 0;
+        sample(solver, dt);
+        return true;
+    }
+
+    // dt is the frame duration the solver was updated with
+    void sample(const PhysicSolver& solver, float dt)
+    {
+        sf::Clock clock;
+        tp::ThreadPool& thread_pool = solver.thread_pool;
+        const uint32_t  cell_count  = getCellCount();
+        if (partials.size() != thread_pool.getBatchCount()) {
+            partials.resize(thread_pool.getBatchCount());
+            for (PartialSums& partial : partials) {
+                partial.count.assign(cell_count, 0.0f);
+                partial.momentum.assign(cell_count, {0.0f, 0.0f});
+                partial.energy.assign(cell_count, 0.0f);
+            }
+        }
+
+        // Verlet velocities are displacements over one sub step
+        const float inv_sub_dt = to<float>(solver.sub_steps) / dt;
+        thread_pool.dispatchIndexed(to<uint32_t>(solver.objects.size()), [&](uint32_t batch, uint32_t start, uint32_t end) {
+            PartialSums& partial = partials[batch];
+            for (uint32_t i{start}; i < end; ++i) {
+                const PhysicObject& obj = solver.objects.data[i];
+                uint32_t index;
+                if (!getCellIndex(obj.position, index)) {
+                    continue;
+                }
+                const Vec2 v = obj.getVelocity() * inv_sub_dt;
+                partial.count[index]    += 1.0f;
+                partial.momentum[index] += v;
+                partial.energy[index]   += MathVec2::length2(v);
+            }
+        });
+
+        // Each cell sums its own entries of every batch, cells are independent
+        const float inv_area = 1.0f / (cell_size * cell_size);
+        thread_pool.dispatch(cell_count, [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                float count    = 0.0f;
+                Vec2  momentum = {0.0f, 0.0f};
+                float energy   = 0.0f;
+                for (PartialSums& partial : partials) {
+                    count    += partial.count[i];
+                    momentum += partial.momentum[i];
+                    energy   += partial.energy[i];
+                    partial.count[i]    = 0.0f;
+                    partial.momentum[i] = {0.0f, 0.0f};
+                    partial.energy[i]   = 0.0f;
+                }
+                density[i] = count * inv_area;
+                if (count > 0.0f) {
+                    const Vec2 mean = momentum / count;
+                    velocity[i]    = mean;
+                    // Spread around the mean velocity, split over the two axes
+                    temperature[i] = std::max(0.0f, 0.5f * (energy / count - MathVec2::length2(mean)));
+                } else {
+                    velocity[i]    = {0.0f, 0.0f};
+                    temperature[i] = 0.0f;
+                }
+            }
+        });
+        ++sample_count;
+        last_sample_time = PhysicSolver::getElapsedMs(clock);
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include "physics/physics.hpp"
+
+
+// Flow quantities measured by a probe, same conventions as FieldSampler
+struct ProbeValues
+{
+    float density     = 0.0f;
+    Vec2  velocity    = {0.0f, 0.0f};
+    float temperature = 0.0f;
+    float pressure    = 0.0f;
+    float mach        = 0.0f;
+};
+
+
+// Region covered by one probe bin, a rectangle along a line or a disc
+struct ProbeBin
+{
+    uint32_t probe;
+    // Reported position
+    Vec2     center;
+    // Rectangle: distance along direction from origin in [along_min, along_max] and across it under half_width
+    Vec2     origin      = {0.0f, 0.0f};
+    Vec2     direction   = {0.0f, 0.0f};
+    float    along_min   = 0.0f;
+    float    along_max   = 0.0f;
+    float    half_width  = 0.0f;
+    // Disc, used when radius is not 0
+    float    radius      = 0.0f;
+    // Collision grid cells overlapping the region, the only ones visited when sampling
+    std::vector<uint32_t> cells;
+    ProbeValues           values;
+
+    [[nodiscard]]
+    bool contains(Vec2 position) const
+    {
+        if (radius > 0.0f) {
+            return MathVec2::length2(position - center) <= radius * radius;
+        }
+        const Vec2  v      = position - origin;
+        const float along  = MathVec2::dot(v, direction);
+        const float across = MathVec2::dot(v, {-direction.y, direction.x});
+        return along >= along_min && along < along_max && std::abs(across) <= half_width;
+    }
+
+    [[nodiscard]]
+    float getArea() const
+    {
+        return radius > 0.0f ? Math::PI * radius * radius : (along_max - along_min) * 2.0f * half_width;
+    }
+};
+
+
+/* Line and point probes read from the collision grid, only the cells they cover are visited.
+   The grid is filled at the beginning of the last sub step, cells are extended by one cell to catch the objects
+   that moved since and objects dropped by full cells are missed. Every sample is appended to a CSV file */
+struct Probes
+{
+    // 2D monatomic gas, two degrees of freedom
+    static constexpr float gamma = 2.0f;
+
+    std::vector<std::string> names;
+    std::vector<ProbeBin>    bins;
+    std::string              csv_path;
+    // A sample is taken every interval calls to update
+    uint32_t                 interval;
+    uint32_t                 calls_count = 0;
+    float                    time        = 0.0f;
+    // Set once a write failed so that the failure is only reported once
+    bool                     write_failed = false;
+
+    explicit
+    Probes(std::string csv_path_, uint32_t interval_ = 30)
+        : csv_path{std::move(csv_path_)}
+        , interval{interval_}
+    {}
+
+    // Bins of half_width around the segment [start, end]
+    void addLine(const PhysicSolver& solver, const std::string& name, Vec2 start, Vec2 end, uint32_t bin_count, float half_width = 1.0f)
+    {
+        const auto  probe     = to<uint32_t>(names.size());
+        const float length    = MathVec2::length(end - start);
+        const Vec2  direction = (end - start) / length;
+        const float bin_size  = length / to<float>(bin_count);
+        names.push_back(name);
+        for (uint32_t i{0}; i < bin_count; ++i) {
+            ProbeBin bin;
+            bin.probe      = probe;
+            bin.origin     = start;
+            bin.direction  = direction;
+            bin.along_min  = to<float>(i) * bin_size;
+            bin.along_max  = to<float>(i + 1) * bin_size;
+            bin.half_width = half_width;
+            bin.center     = start + direction * ((to<float>(i) + 0.5f) * bin_size);
+            const Vec2 normal{-direction.y, direction.x};
+            const Vec2 corners[] = {start + direction * bin.along_min + normal * half_width,
+                                    start + direction * bin.along_min - normal * half_width,
+                                    start + direction * bin.along_max + normal * half_width,
+                                    start + direction * bin.along_max - normal * half_width};
+            Vec2 min = corners[0];
+            Vec2 max = corners[0];
+            for (const Vec2 corner : corners) {
+                min = {std::min(min.x, corner.x), std::min(min.y, corner.y)};
+                max = {std::max(max.x, corner.x), std::max(max.y, corner.y)};
+            }
+            addCells(solver, bin, min, max);
+            bins.push_back(bin);
+        }
+    }
+
+    void addPoint(const PhysicSolver& solver, const std::string& name, Vec2 center, float radius)
+    {
+        ProbeBin bin;
+        bin.probe  = to<uint32_t>(names.size());
+        bin.center = center;
+        bin.radius = radius;
+        names.push_back(name);
+        addCells(solver, bin, center - Vec2{radius, radius}, center + Vec2{radius, radius});
+        bins.push_back(bin);
+    }
+
+    // To be called once per frame after the solver update, returns true if a sample was taken
+    bool update(const PhysicSolver& solver, float dt)
+    {
+        time += dt;
+        if (++calls_count < interval) {
+            return false;
+        }
+        calls_count = 0;
+        sample(solver, dt);
+        if (!writeCSV() && !write_failed) {
+            printf("Probes %s: cannot be written\n", csv_path.c_str());
+            write_failed = true;
+        }
+        return true;
+    }
+
+    // dt is the frame duration the solver was updated with
+    void sample(const PhysicSolver& solver, float dt)
+    {
+        const float inv_sub_dt = to<float>(solver.sub_steps) / dt;
+        solver.thread_pool.dispatch(to<uint32_t>(bins.size()), [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                ProbeBin& bin = bins[i];
+                float count    = 0.0f;
+                Vec2  momentum = {0.0f, 0.0f};
+                float energy   = 0.0f;
+                for (const uint32_t cell_index : bin.cells) {
+                    const CollisionCell& cell = solver.grid.data[cell_index];
+                    for (uint32_t k{0}; k < cell.objects_count; ++k) {
+                        const PhysicObject& obj = solver.objects.data[cell.objects[k]];
+                        if (!bin.contains(obj.position)) {
+                            continue;
+                        }
+                        const Vec2 v = obj.getVelocity() * inv_sub_dt;
+                        count    += 1.0f;
+                        momentum += v;
+                        energy   += MathVec2::length2(v);
+                    }
+                }
+                bin.values = computeValues(count, momentum, energy, bin.getArea());
+            }
+        });
+    }
+
+    static ProbeValues computeValues(float count, Vec2 momentum, float energy, float area)
+    {
+        ProbeValues values;
+        values.density = count / area;
+        if (count > 0.0f) {
+            values.velocity    = momentum / count;
+            values.temperature = std::max(0.0f, 0.5f * (energy / count - MathVec2::length2(values.velocity)));
+            values.pressure    = values.density * values.temperature;
+            if (values.temperature > 0.0f) {
+                values.mach = MathVec2::length(values.velocity) / std::sqrt(gamma * values.temperature);
+            }
+        }
+        return values;
+    }
+
+    // Appends the last sample, the header is written when the file is created
+    bool writeCSV() const
+    {
+        FILE* file = std::fopen(csv_path.c_str(), "a");
+        if (!file) {
+            return false;
+        }
+        std::fseek(file, 0, SEEK_END);
+        if (std::ftell(file) == 0) {
+            std::fprintf(file, "time,probe,bin,x,y,density,vx,vy,temperature,pressure,mach\n");
+        }
+        uint32_t bin_index = 0;
+        for (uint32_t i{0}; i < bins.size(); ++i) {
+            const ProbeBin& bin = bins[i];
+            bin_index = (i && bins[i - 1].probe == bin.probe) ? bin_index + 1 : 0;
+            const ProbeValues& v = bin.values;
+            std::fprintf(file, "%g,%s,%u,%g,%g,%g,%g,%g,%g,%g,%g\n", time, names[bin.probe].c_str(), bin_index,
+                         bin.center.x, bin.center.y, v.density, v.velocity.x, v.velocity.y, v.temperature, v.pressure, v.mach);
+        }
+        const bool success = !std::ferror(file);
+        return (std::fclose(file) == 0) && success;
+    }
+
+private:
+    // Grid cells overlapping [min, max] with a one cell margin, the grid safety border is left out
+    static void addCells(const PhysicSolver& solver, ProbeBin& bin, Vec2 min, Vec2 max)
+    {
+        const CollisionGrid& grid = solver.grid;
+        const int32_t x_min = std::max(to<int32_t>(std::floor(min.x)) - 1, 1);
+        const int32_t y_min = std::max(to<int32_t>(std::floor(min.y)) - 1, 1);
+        const int32_t x_max = std::min(to<int32_t>(std::floor(max.x)) + 1, grid.width - 2);
+        const int32_t y_max = std::min(to<int32_t>(std::floor(max.y)) + 1, grid.height - 2);
+        for (int32_t x{x_min}; x <= x_max; ++x) {
+            for (int32_t y{y_min}; y <= y_max; ++y) {
+                bin.cells.push_back(grid.getCellIndex(x, y));
+            }
+        }
+    }
+};
@@ -0,0 +1,225 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include "physics/physics.hpp"
+
+
+/* Histograms of vx, vy and speed of the objects of a region, accumulated over samples until reset.
+   A region is a set of collision grid cells, optionally restricted to a rectangle. Each batch of cells fills
+   its own bins which are merged after every sample, no atomic is involved */
+struct VelocityHistogram
+{
+    enum Component
+    {
+        VelocityX = 0,
+        VelocityY = 1,
+        Speed     = 2,
+        ComponentsCount,
+    };
+
+    // Sums used to compare the histograms to a Maxwellian
+    struct Moments
+    {
+        double count      = 0.0;
+        double velocity_x = 0.0;
+        double velocity_y = 0.0;
+        double energy     = 0.0;
+
+        void merge(const Moments& other)
+        {
+            count      += other.count;
+            velocity_x += other.velocity_x;
+            velocity_y += other.velocity_y;
+            energy     += other.energy;
+        }
+    };
+
+    std::vector<uint32_t> cells;
+    Vec2                  rectangle_min = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+    Vec2                  rectangle_max = { std::numeric_limits<float>::max(),  std::numeric_limits<float>::max()};
+    uint32_t              bin_count;
+    // Components are binned in [-max_velocity, max_velocity] and speed in [0, max_velocity]
+    float                 max_velocity;
+
+    uint64_t              sample_count = 0;
+    std::vector<uint64_t> bins;
+    Moments               moments;
+
+    std::vector<std::vector<uint32_t>> batch_bins;
+    std::vector<Moments>               batch_moments;
+
+    VelocityHistogram(std::vector<uint32_t> cells_, uint32_t bin_count_, float max_velocity_)
+        : cells{std::move(cells_)}
+        , bin_count{bin_count_}
+        , max_velocity{max_velocity_}
+        , bins(ComponentsCount * bin_count_, 0)
+    {}
+
+    // Region covering the objects inside [min, max]
+    static VelocityHistogram createRectangle(const PhysicSolver& solver, Vec2 min, Vec2 max, uint32_t bin_count, float max_velocity)
+    {
+        // One cell margin for the objects that moved since the grid was filled
+        const CollisionGrid& grid = solver.grid;
+        const int32_t x_min = std::max(to<int32_t>(std::floor(min.x)) - 1, 1);
+        const int32_t y_min = std::max(to<int32_t>(std::floor(min.y)) - 1, 1);
+        const int32_t x_max = std::min(to<int32_t>(std::floor(max.x)) + 1, grid.width - 2);
+        const int32_t y_max = std::min(to<int32_t>(std::floor(max.y)) + 1, grid.height - 2);
+        std::vector<uint32_t> cells;
+        for (int32_t x{x_min}; x <= x_max; ++x) {
+            for (int32_t y{y_min}; y <= y_max; ++y) {
+                cells.push_back(grid.getCellIndex(x, y));
+            }
+        }
+        VelocityHistogram histogram{std::move(cells), bin_count, max_velocity};
+        histogram.rectangle_min = min;
+        histogram.rectangle_max = max;
+        return histogram;
+    }
+
+    // dt is the frame duration the solver was updated with
+    void sample(const PhysicSolver& solver, float dt)
+    {
+        tp::ThreadPool& thread_pool = solver.thread_pool;
+        const uint32_t  batch_count = thread_pool.getBatchCount();
+        if (batch_bins.size() != batch_count) {
+            batch_bins.assign(batch_count, std::vector<uint32_t>(bins.size(), 0));
+        }
+        batch_moments.resize(batch_count);
+
+        const float inv_sub_dt = to<float>(solver.sub_steps) / dt;
+        thread_pool.dispatchIndexed(to<uint32_t>(cells.size()), [&](uint32_t batch, uint32_t start, uint32_t end) {
+            std::vector<uint32_t>& local_bins    = batch_bins[batch];
+            Moments&               local_moments = batch_moments[batch];
+            local_moments = {};
+            for (uint32_t i{start}; i < end; ++i) {
+                const CollisionCell& cell = solver.grid.data[cells[i]];
+                for (uint32_t k{0}; k < cell.objects_count; ++k) {
+                    const PhysicObject& obj = solver.objects.data[cell.objects[k]];
+                    if (!isInRectangle(obj.position)) {
+                        continue;
+                    }
+                    const Vec2  v     = obj.getVelocity() * inv_sub_dt;
+                    const float speed = MathVec2::length(v);
+                    addValue(local_bins, VelocityX, v.x, -max_velocity);
+                    addValue(local_bins, VelocityY, v.y, -max_velocity);
+                    addValue(local_bins, Speed, speed, 0.0f);
+                    local_moments.count      += 1.0;
+                    local_moments.velocity_x += v.x;
+                    local_moments.velocity_y += v.y;
+                    local_moments.energy     += speed * speed;
+                }
+            }
+        });
+
+        thread_pool.dispatch(to<uint32_t>(bins.size()), [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                for (std::vector<uint32_t>& local_bins : batch_bins) {
+                    bins[i] += local_bins[i];
+                    local_bins[i] = 0;
+                }
+            }
+        });
+        for (const Moments& local_moments : batch_moments) {
+            moments.merge(local_moments);
+        }
+        ++sample_count;
+    }
+
+    void reset()
+    {
+        std::fill(bins.begin(), bins.end(), 0);
+        moments      = {};
+        sample_count = 0;
+    }
+
+    [[nodiscard]]
+    bool isInRectangle(Vec2 position) const
+    {
+        return position.x >= rectangle_min.x && position.x < rectangle_max.x &&
+               position.y >= rectangle_min.y && position.y < rectangle_max.y;
+    }
+
+    [[nodiscard]]
+    float getBinWidth(Component component) const
+    {
+        return (component == Speed ? 1.0f : 2.0f) * max_velocity / to<float>(bin_count);
+    }
+
+    [[nodiscard]]
+    float getBinCenter(Component component, uint32_t bin) const
+    {
+        const float range_start = component == Speed ? 0.0f : -max_velocity;
+        return range_start + (to<float>(bin) + 0.5f) * getBinWidth(component);
+    }
+
+    [[nodiscard]]
+    Vec2 getMeanVelocity() const
+    {
+        if (moments.count == 0.0) {
+            return {0.0f, 0.0f};
+        }
+        return {to<float>(moments.velocity_x / moments.count), to<float>(moments.velocity_y / moments.count)};
+    }
+
+    // Kinetic temperature of the accumulated objects, FieldSampler conventions
+    [[nodiscard]]
+    float getTemperature() const
+    {
+        if (moments.count == 0.0) {
+            return 0.0f;
+        }
+        return std::max(0.0f, 0.5f * (to<float>(moments.energy / moments.count) - MathVec2::length2(getMeanVelocity())));
+    }
+
+    /* Probability density of a Maxwellian with the measured mean velocity and temperature.
+       The speed reference ignores the bulk velocity, it is only meaningful for gas at rest */
+    [[nodiscard]]
+    float getMaxwellian(Component component, float value) const
+    {
+        const float temperature = getTemperature();
+        if (temperature <= 0.0f) {
+            return 0.0f;
+        }
+        if (component == Speed) {
+            return value / temperature * std::exp(-value * value / (2.0f * temperature));
+        }
+        const Vec2  mean = getMeanVelocity();
+        const float d    = value - (component == VelocityX ? mean.x : mean.y);
+        return std::exp(-d * d / (2.0f * temperature)) / std::sqrt(2.0f * Math::PI * temperature);
+    }
+
+    // One row per bin and component, counts are normalized into probability densities next to the Maxwellian
+    bool exportCSV(const std::string& path) const
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+        std::fprintf(file, "component,velocity,count,density,maxwellian\n");
+        const char* names[] = {"vx", "vy", "speed"};
+        const auto  total   = to<float>(std::max(moments.count, 1.0));
+        for (uint32_t c{0}; c < ComponentsCount; ++c) {
+            const auto component = static_cast<Component>(c);
+            for (uint32_t i{0}; i < bin_count; ++i) {
+                const uint64_t count    = bins[c * bin_count + i];
+                const float    velocity = getBinCenter(component, i);
+                std::fprintf(file, "%s,%g,%lu,%g,%g\n", names[c], velocity, static_cast<unsigned long>(count),
+                             to<float>(count) / (total * getBinWidth(component)), getMaxwellian(component, velocity));
+            }
+        }
+        std::fclose(file);
+        return true;
+    }
+
+private:
+    // Values out of range are dropped from the bins but still count in the moments
+    void addValue(std::vector<uint32_t>& local_bins, Component component, float value, float range_start) const
+    {
+        const auto bin = to<int32_t>(std::floor((value - range_start) / getBinWidth(component)));
+        if (bin >= 0 && bin < to<int32_t>(bin_count)) {
+            ++local_bins[component * bin_count + bin];
+        }
+    }
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <array>
+#include <limits>
 #include <SFML/Graphics/Color.hpp>
 #include "utils.hpp"
 #include "math.hpp"
@@ -35,4 +37,46 @@ struct ColorUtils
         return createColor(255 * r * r, 255 * g * g, 255 * b * b);
     }
 
+    // 256 colors palette: a full rainbow period followed by 16 grey levels
+    static const std::array<sf::Color, 256>& getPalette()
+    {
+        static const std::array<sf::Color, 256> palette = []{
+            constexpr uint32_t rainbow_size = 240;
+            std::array<sf::Color, 256> colors;
+            for (uint32_t i{0}; i < rainbow_size; ++i) {
+                colors[i] = getRainbow(to<float>(i) * Math::PI / to<float>(rainbow_size));
+            }
+            for (uint32_t i{rainbow_size}; i < 256; ++i) {
+                const auto level = to<uint8_t>((i - rainbow_size) * 17);
+                colors[i] = {level, level, level};
+            }
+            return colors;
+        }();
+        return palette;
+    }
+
+    static sf::Color getPaletteColor(uint8_t index)
+    {
+        return getPalette()[index];
+    }
+
+    // Index of the closest palette color
+    static uint8_t getPaletteIndex(sf::Color color)
+    {
+        uint8_t  best          = 0;
+        uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+        for (uint32_t i{0}; i < 256; ++i) {
+            const sf::Color c = getPalette()[i];
+            const int32_t dr = c.r - color.r;
+            const int32_t dg = c.g - color.g;
+            const int32_t db = c.b - color.b;
+            const auto distance = to<uint32_t>(dr * dr + dg * dg + db * db);
+            if (distance < best_distance) {
+                best_distance = distance;
+                best          = to<uint8_t>(i);
+            }
+        }
+        return best;
+    }
+
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <cstdint>
+#include <algorithm>
 
 
 namespace civ
@@ -91,11 +92,19 @@ struct Vector : public GenericProvider
     template<typename... Args>
     ID                 emplace_back(Args&&... args);
     ID                 push_back(const T& obj);
+    // Appends count default constructed objects and returns the data index of the first one
+    uint64_t           grow(uint64_t count);
+    void               reserve(uint64_t capacity);
     [[nodiscard]]
     ID                 getNextID() const;
     void               erase(ID id);
     template<typename TPredicate>
     void               remove_if(TPredicate&& f);
+    // Removes flagged objects preserving the order of the remaining ones
+    template<typename TDispatcher>
+    uint64_t           compact(const std::vector<uint8_t>& remove, TDispatcher&& dispatch);
+    template<typename TDispatcher, typename TCallback>
+    uint64_t           compact(const std::vector<uint8_t>& remove, TDispatcher&& dispatch, TCallback&& on_move);
     void               clear();
     // Data access by ID
     T&                 operator[](ID id);
@@ -132,6 +141,9 @@ public:
     std::vector<SlotMetadata> metadata;
     uint64_t                  data_size;
     uint64_t                  op_count;
+    // Scratch buffers reused by compact
+    std::vector<T>            compact_data;
+    std::vector<SlotMetadata> compact_metadata;
 
     [[nodiscard]]
     bool          isFull() const;
@@ -172,6 +184,35 @@ inline uint64_t Vector<T>::push_back(const T& obj)
     return slot.id;
 }
 
+template<typename T>
+inline uint64_t Vector<T>::grow(uint64_t count)
+{
+    const uint64_t first    = data_size;
+    const uint64_t new_size = data_size + count;
+    // Reuse free slots first
+    const uint64_t reused_end = std::min<uint64_t>(new_size, data.size());
+    for (uint64_t i{data_size}; i < reused_end; ++i) {
+        metadata[i].op_id = op_count++;
+        new(&data[i]) T();
+    }
+    // Then create the missing ones
+    for (uint64_t i{data.size()}; i < new_size; ++i) {
+        ids.push_back(i);
+        metadata.push_back({i, op_count++});
+    }
+    data.resize(std::max<uint64_t>(new_size, data.size()));
+    data_size = new_size;
+    return first;
+}
+
+template<typename T>
+inline void Vector<T>::reserve(uint64_t capacity)
+{
+    data.reserve(capacity);
+    ids.reserve(capacity);
+    metadata.reserve(capacity);
+}
+
 template<typename T>
 inline void Vector<T>::erase(ID id)
 {
@@ -344,6 +385,89 @@ void Vector<T>::remove_if(TPredicate&& f)
     }
 }
 
+template<typename T>
+template<typename TDispatcher>
+uint64_t Vector<T>::compact(const std::vector<uint8_t>& remove, TDispatcher&& dispatch)
+{
+    return compact(remove, std::forward<TDispatcher>(dispatch), [](uint64_t, uint64_t){});
+}
+
+/* The work is split in fixed size chunks so that the result does not depend on the dispatcher.
+   dispatch(count, callback(start, end)) has to call callback on ranges covering [0, count),
+   possibly in parallel. on_move(old_index, new_index) is called for each kept object. */
+template<typename T>
+template<typename TDispatcher, typename TCallback>
+uint64_t Vector<T>::compact(const std::vector<uint8_t>& remove, TDispatcher&& dispatch, TCallback&& on_move)
+{
+    constexpr uint64_t chunk_size  = 4096;
+    const uint64_t     chunk_count = (data_size + chunk_size - 1) / chunk_size;
+    const auto chunk_end = [this](uint64_t c) { return std::min(data_size, (c + 1) * chunk_size); };
+    // Count kept objects in each chunk
+    std::vector<uint64_t> kept_count(chunk_count);
+    dispatch(static_cast<uint32_t>(chunk_count), [&](uint32_t start, uint32_t end) {
+        for (uint64_t c{start}; c < end; ++c) {
+            uint64_t kept = 0;
+            for (uint64_t i{c * chunk_size}; i < chunk_end(c); ++i) {
+                kept += !remove[i];
+            }
+            kept_count[c] = kept;
+        }
+    });
+    uint64_t new_size = 0;
+    for (const uint64_t kept : kept_count) {
+        new_size += kept;
+    }
+    if (new_size == data_size) {
+        return 0;
+    }
+    // Prefix sums give the destination of each chunk, removed objects go after the kept ones
+    std::vector<uint64_t> kept_offset(chunk_count);
+    std::vector<uint64_t> removed_offset(chunk_count);
+    uint64_t kept_total    = 0;
+    uint64_t removed_total = new_size;
+    for (uint64_t c{0}; c < chunk_count; ++c) {
+        kept_offset[c]    = kept_total;
+        removed_offset[c] = removed_total;
+        kept_total    += kept_count[c];
+        removed_total += chunk_end(c) - c * chunk_size - kept_count[c];
+    }
+    compact_data.resize(data_size);
+    compact_metadata.resize(data_size);
+    const uint64_t first_op_id = op_count;
+    dispatch(static_cast<uint32_t>(chunk_count), [&](uint32_t start, uint32_t end) {
+        for (uint64_t c{start}; c < end; ++c) {
+            uint64_t kept_idx    = kept_offset[c];
+            uint64_t removed_idx = removed_offset[c];
+            for (uint64_t i{c * chunk_size}; i < chunk_end(c); ++i) {
+                const uint64_t dst = remove[i] ? removed_idx++ : kept_idx++;
+                compact_data[dst]     = std::move(data[i]);
+                compact_metadata[dst] = metadata[i];
+                if (remove[i]) {
+                    // Invalidate the operation ID
+                    compact_metadata[dst].op_id = first_op_id + dst - new_size + 1;
+                } else {
+                    on_move(i, dst);
+                }
+            }
+        }
+    });
+    op_count += data_size - new_size;
+    // Copy back and update the ids, slots after data_size are left untouched
+    dispatch(static_cast<uint32_t>(chunk_count), [&](uint32_t start, uint32_t end) {
+        for (uint64_t i{start * chunk_size}; i < std::min(data_size, end * chunk_size); ++i) {
+            data[i]     = std::move(compact_data[i]);
+            metadata[i] = compact_metadata[i];
+            ids[metadata[i].rid] = i;
+            if (i >= new_size) {
+                data[i].~T();
+            }
+        }
+    });
+    const uint64_t removed = data_size - new_size;
+    data_size = new_size;
+    return removed;
+}
+
 template<typename T>
 ID Vector<T>::getNextID() const {
     return isFull() ? data_size : metadata[data_size].rid;
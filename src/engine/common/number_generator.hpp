@@ -155,3 +155,23 @@ using RNGi32 = RNGi<int32_t>;
 using RNGi64 = RNGi<int64_t>;
 using RNGu32 = RNGi<uint32_t>;
 using RNGu64 = RNGi<uint64_t>;
+
+
+// Stateless generator, a given (seed, counter) pair always yields the same number whichever thread asks for it
+struct CounterRNG
+{
+	static uint64_t hash(uint64_t x)
+	{
+		// splitmix64 finalizer
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	// Uniform in [0, 1)
+	static float get(uint64_t seed, uint64_t counter)
+	{
+		return static_cast<float>(hash(seed ^ hash(counter)) >> 40) * (1.0f / 16777216.0f);
+	}
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+
+
+/* Frames read back from the window are queued in a fixed ring of buffers and saved to image files by a pool
+   of encoder threads. When every buffer is still waiting to be encoded, a capture either blocks until one is
+   released or drops the frame */
+class FrameCapture
+{
+public:
+    enum class Policy
+    {
+        Block,
+        Drop,
+    };
+
+    FrameCapture(sf::Vector2u frame_size, uint32_t ring_size, uint32_t encoder_count, Policy policy = Policy::Drop)
+        : m_policy{policy}
+        , m_slots(ring_size)
+    {
+        for (uint32_t i{0}; i < ring_size; ++i) {
+            m_slots[i].pixels.resize(static_cast<std::size_t>(frame_size.x) * frame_size.y * 4);
+            m_free.push_back(i);
+        }
+        for (uint32_t i{0}; i < encoder_count; ++i) {
+            m_encoders.emplace_back([this]() { encodeLoop(); });
+        }
+    }
+
+    ~FrameCapture()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stopping = true;
+        }
+        m_queued_condition.notify_all();
+        for (std::thread& encoder : m_encoders) {
+            encoder.join();
+        }
+    }
+
+    // Reads the back buffer of the window, to be called once the frame is drawn and before it is displayed
+    bool capture(sf::RenderWindow& window, const std::string& path)
+    {
+        uint32_t slot_index;
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            if (m_free.empty()) {
+                if (m_policy == Policy::Drop) {
+                    ++m_dropped;
+                    return false;
+                }
+                sf::Clock clock;
+                m_free_condition.wait(lock, [this]() { return !m_free.empty(); });
+                m_stall_time += clock.getElapsedTime().asSeconds();
+            }
+            slot_index = m_free.front();
+            m_free.pop_front();
+        }
+        Slot& slot = m_slots[slot_index];
+        readPixels(window, slot.pixels, slot.size);
+        slot.path = path;
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_queued.push_back(slot_index);
+            ++m_captured;
+        }
+        m_queued_condition.notify_one();
+        return true;
+    }
+
+    // Blocks until every captured frame is written
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_free_condition.wait(lock, [this]() { return m_free.size() == m_slots.size(); });
+    }
+
+    /* Synchronous read back of the window back buffer in RGBA, rows go from the bottom of the frame to its top.
+       The buffer is only resized when the window size changed */
+    static void readPixels(sf::RenderWindow& window, std::vector<sf::Uint8>& pixels, sf::Vector2u& size)
+    {
+        size = window.getSize();
+        pixels.resize(static_cast<std::size_t>(size.x) * size.y * 4);
+        if (window.setActive(true)) {
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        }
+    }
+
+    [[nodiscard]]
+    uint64_t getCapturedCount() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_captured;
+    }
+
+    [[nodiscard]]
+    uint64_t getWrittenCount() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_written;
+    }
+
+    [[nodiscard]]
+    uint64_t getDroppedCount() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_dropped;
+    }
+
+    [[nodiscard]]
+    uint64_t getFailedCount() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_failed;
+    }
+
+    // Time spent by capture waiting for a free buffer, in seconds
+    [[nodiscard]]
+    float getStallTime() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_stall_time;
+    }
+
+private:
+    struct Slot
+    {
+        std::vector<sf::Uint8> pixels;
+        sf::Vector2u           size;
+        std::string            path;
+    };
+
+    void encodeLoop()
+    {
+        sf::Image image;
+        while (true) {
+            uint32_t slot_index;
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_queued_condition.wait(lock, [this]() { return !m_queued.empty() || m_stopping; });
+                // Queued frames are still written when stopping
+                if (m_queued.empty()) {
+                    return;
+                }
+                slot_index = m_queued.front();
+                m_queued.pop_front();
+            }
+            const Slot& slot = m_slots[slot_index];
+            image.create(slot.size.x, slot.size.y, slot.pixels.data());
+            image.flipVertically();
+            const bool success = image.saveToFile(slot.path);
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                ++(success ? m_written : m_failed);
+                m_free.push_back(slot_index);
+            }
+            m_free_condition.notify_all();
+        }
+    }
+
+    Policy                   m_policy;
+    std::vector<Slot>        m_slots;
+    std::deque<uint32_t>     m_free;
+    std::deque<uint32_t>     m_queued;
+    std::vector<std::thread> m_encoders;
+    mutable std::mutex       m_mutex;
+    std::condition_variable  m_queued_condition;
+    std::condition_variable  m_free_condition;
+    bool                     m_stopping   = false;
+    uint64_t                 m_captured   = 0;
+    uint64_t                 m_written    = 0;
+    uint64_t                 m_dropped    = 0;
+    uint64_t                 m_failed     = 0;
+    float                    m_stall_time = 0.0f;
+};
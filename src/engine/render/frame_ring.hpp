@@ -0,0 +1,255 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "frame_capture.hpp"
+#include "video_stream.hpp"
+#include "thread_pool/thread_pool.hpp"
+#include "engine/common/utils.hpp"
+
+
+/* Keeps the last frames in memory, nothing is encoded or written until they are saved.
+   Frames can be downscaled by an integer factor and stored raw or run length encoded, which suits the mostly
+   uniform background of the simulation. An encoded frame larger than the raw one is stored raw, so the ring never
+   takes more than capacity raw frames. Pixels are RGBA with rows from bottom to top, as read back.
+   A ring without capacity is disabled, pushing into it does not even read the window back */
+class FrameRing
+{
+public:
+    enum class Storage
+    {
+        Raw,
+        // Runs of identical pixels stored as a count followed by the pixel
+        RunLength,
+    };
+
+    FrameRing(sf::Vector2u window_size, uint32_t capacity, uint32_t downscale = 1, Storage storage = Storage::Raw)
+        : m_downscale{std::max(downscale, 1u)}
+        , m_size{window_size.x / m_downscale, window_size.y / m_downscale}
+        , m_storage{storage}
+        , m_slots(capacity)
+    {
+        if (m_storage == Storage::Raw) {
+            for (Slot& slot : m_slots) {
+                slot.data.reserve(getFrameBytes());
+            }
+        }
+    }
+
+    // Reads back the frame being drawn in place of the oldest one, to be called before display
+    void push(sf::RenderWindow& window, tp::ThreadPool& thread_pool)
+    {
+        if (m_slots.empty()) {
+            return;
+        }
+        sf::Vector2u window_size;
+        FrameCapture::readPixels(window, m_readback, window_size);
+        // The stored size is fixed, a resized window is cropped or padded
+        m_window_size = window_size;
+        Slot& slot = m_slots[m_next];
+        downscale(thread_pool);
+        slot.raw = m_storage == Storage::Raw || !encode(slot, thread_pool);
+        if (slot.raw) {
+            slot.data = m_frame;
+        }
+        m_next  = (m_next + 1) % to<uint32_t>(m_slots.size());
+        m_count = std::min(m_count + 1, to<uint32_t>(m_slots.size()));
+    }
+
+    [[nodiscard]]
+    uint32_t getCapacity() const
+    {
+        return to<uint32_t>(m_slots.size());
+    }
+
+    [[nodiscard]]
+    uint32_t getCount() const
+    {
+        return m_count;
+    }
+
+    [[nodiscard]]
+    sf::Vector2u getFrameSize() const
+    {
+        return m_size;
+    }
+
+    [[nodiscard]]
+    uint64_t getMemoryUsage() const
+    {
+        uint64_t bytes = 0;
+        for (const Slot& slot : m_slots) {
+            bytes += slot.data.capacity() + slot.row_offsets.capacity() * sizeof(uint32_t);
+        }
+        return bytes;
+    }
+
+    // Writes the stored frames from the oldest to the newest as a Y4M video
+    bool saveVideo(const std::string& path, uint32_t fps, tp::ThreadPool& thread_pool)
+    {
+        VideoStream stream;
+        if (!stream.open(path, VideoStream::Format::Y4M, m_size, fps)) {
+            return false;
+        }
+        for (uint32_t i{0}; i < m_count; ++i) {
+            decode(getSlot(i), thread_pool);
+            if (!stream.write(m_frame, m_size, thread_pool)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Saves one stored frame as an image, 0 being the newest one
+    bool saveImage(uint32_t age, const std::string& path, tp::ThreadPool& thread_pool)
+    {
+        if (age >= m_count) {
+            return false;
+        }
+        decode(getSlot(m_count - 1 - age), thread_pool);
+        sf::Image image;
+        image.create(m_size.x, m_size.y, m_frame.data());
+        image.flipVertically();
+        return image.saveToFile(path);
+    }
+
+private:
+    struct Slot
+    {
+        std::vector<sf::Uint8> data;
+        // Start of each row in data when run length encoded
+        std::vector<uint32_t>  row_offsets;
+        bool                   raw = false;
+    };
+
+    // i = 0 is the oldest stored frame
+    const Slot& getSlot(uint32_t i) const
+    {
+        const auto capacity = to<uint32_t>(m_slots.size());
+        return m_slots[(m_next + capacity - m_count + i) % capacity];
+    }
+
+    [[nodiscard]]
+    std::size_t getFrameBytes() const
+    {
+        return static_cast<std::size_t>(m_size.x) * m_size.y * 4;
+    }
+
+    // Box filter over downscale x downscale blocks
+    void downscale(tp::ThreadPool& thread_pool)
+    {
+        m_frame.resize(getFrameBytes());
+        const uint32_t d    = m_downscale;
+        const uint32_t area = d * d;
+        thread_pool.dispatch(m_size.y, [&](uint32_t start, uint32_t end) {
+            for (uint32_t y{start}; y < end; ++y) {
+                sf::Uint8* out = m_frame.data() + static_cast<std::size_t>(y) * m_size.x * 4;
+                for (uint32_t x{0}; x < m_size.x; ++x) {
+                    uint32_t sum[4] = {0, 0, 0, 0};
+                    for (uint32_t dy{0}; dy < d; ++dy) {
+                        const uint32_t src_y = y * d + dy;
+                        for (uint32_t dx{0}; dx < d; ++dx) {
+                            const uint32_t src_x = x * d + dx;
+                            if (src_x >= m_window_size.x || src_y >= m_window_size.y) {
+                                continue;
+                            }
+                            const sf::Uint8* pixel = m_readback.data() + (static_cast<std::size_t>(src_y) * m_window_size.x + src_x) * 4;
+                            for (uint32_t c{0}; c < 4; ++c) {
+                                sum[c] += pixel[c];
+                            }
+                        }
+                    }
+                    for (uint32_t c{0}; c < 4; ++c) {
+                        out[4 * x + c] = static_cast<sf::Uint8>(sum[c] / area);
+                    }
+                }
+            }
+        });
+    }
+
+    /* Each batch of rows is encoded in its own buffer, buffers are then appended in rows order.
+       Returns false, leaving the slot to be stored raw, if the encoded frame is larger than the raw one */
+    bool encode(Slot& slot, tp::ThreadPool& thread_pool)
+    {
+        const uint32_t batch_count = thread_pool.getBatchCount();
+        m_batch_data.resize(batch_count);
+        m_batch_rows.resize(batch_count);
+        slot.row_offsets.resize(m_size.y);
+        thread_pool.dispatchIndexed(m_size.y, [&](uint32_t batch, uint32_t start, uint32_t end) {
+            std::vector<sf::Uint8>& data = m_batch_data[batch];
+            data.clear();
+            m_batch_rows[batch] = {start, end};
+            for (uint32_t y{start}; y < end; ++y) {
+                // Offsets are local to the batch until the buffers are appended
+                slot.row_offsets[y] = to<uint32_t>(data.size());
+                const sf::Uint8* row = m_frame.data() + static_cast<std::size_t>(y) * m_size.x * 4;
+                uint32_t x = 0;
+                while (x < m_size.x) {
+                    uint32_t run = 1;
+                    while (x + run < m_size.x && run < 255 && std::equal(row + 4 * x, row + 4 * x + 4, row + 4 * (x + run))) {
+                        ++run;
+                    }
+                    data.push_back(static_cast<sf::Uint8>(run));
+                    data.insert(data.end(), row + 4 * x, row + 4 * x + 4);
+                    x += run;
+                }
+            }
+        });
+        std::size_t encoded_bytes = 0;
+        for (const std::vector<sf::Uint8>& data : m_batch_data) {
+            encoded_bytes += data.size();
+        }
+        if (encoded_bytes > getFrameBytes()) {
+            return false;
+        }
+        slot.data.clear();
+        for (uint32_t batch{0}; batch < batch_count; ++batch) {
+            const auto base = to<uint32_t>(slot.data.size());
+            for (uint32_t y{m_batch_rows[batch].first}; y < m_batch_rows[batch].second; ++y) {
+                slot.row_offsets[y] += base;
+            }
+            slot.data.insert(slot.data.end(), m_batch_data[batch].begin(), m_batch_data[batch].end());
+        }
+        return true;
+    }
+
+    void decode(const Slot& slot, tp::ThreadPool& thread_pool)
+    {
+        if (slot.raw) {
+            m_frame = slot.data;
+            return;
+        }
+        m_frame.resize(getFrameBytes());
+        thread_pool.dispatch(m_size.y, [&](uint32_t start, uint32_t end) {
+            for (uint32_t y{start}; y < end; ++y) {
+                const sf::Uint8* in  = slot.data.data() + slot.row_offsets[y];
+                sf::Uint8*       out = m_frame.data() + static_cast<std::size_t>(y) * m_size.x * 4;
+                uint32_t x = 0;
+                while (x < m_size.x) {
+                    const uint32_t run = in[0];
+                    for (uint32_t i{0}; i < run; ++i) {
+                        std::copy_n(in + 1, 4, out + 4 * (x + i));
+                    }
+                    x  += run;
+                    in += 5;
+                }
+            }
+        });
+    }
+
+    uint32_t               m_downscale;
+    sf::Vector2u           m_size;
+    Storage                m_storage;
+    std::vector<Slot>      m_slots;
+    uint32_t               m_next  = 0;
+    uint32_t               m_count = 0;
+    sf::Vector2u           m_window_size;
+    std::vector<sf::Uint8> m_readback;
+    // Last pushed or decoded frame
+    std::vector<sf::Uint8> m_frame;
+    std::vector<std::vector<sf::Uint8>> m_batch_data;
+    // Rows encoded by each batch
+    std::vector<std::pair<uint32_t, uint32_t>> m_batch_rows;
+};
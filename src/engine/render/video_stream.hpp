@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "thread_pool/thread_pool.hpp"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+/* Uncompressed video written to a single file or to the standard output, to be piped into an encoder:
+   ffmpeg -i - out.mp4 for Y4M, or with -f rawvideo -pix_fmt rgba -s WxH -r FPS for raw RGBA.
+   Frames are converted in parallel on the thread pool and written synchronously */
+class VideoStream
+{
+public:
+    enum class Format
+    {
+        // YUV 4:2:0 with BT.601 limited range
+        Y4M,
+        // RGBA bytes, rows from top to bottom
+        RawRGBA,
+    };
+
+    VideoStream() = default;
+    VideoStream(const VideoStream&) = delete;
+    VideoStream& operator=(const VideoStream&) = delete;
+
+    ~VideoStream()
+    {
+        close();
+    }
+
+    // A path of "-" selects the standard output, regular output is then sent to the standard error
+    bool open(const std::string& path, Format format, sf::Vector2u size, uint32_t fps)
+    {
+        close();
+        m_format = format;
+        m_size   = size;
+        if (path == "-") {
+            std::fflush(stdout);
+#ifdef _WIN32
+            const int fd = _dup(_fileno(stdout));
+            _dup2(_fileno(stderr), _fileno(stdout));
+            _setmode(fd, _O_BINARY);
+            m_file = _fdopen(fd, "wb");
+#else
+            const int fd = dup(STDOUT_FILENO);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+            m_file = fdopen(fd, "wb");
+#endif
+        } else {
+            m_file = std::fopen(path.c_str(), "wb");
+        }
+        if (!m_file) {
+            return false;
+        }
+        if (m_format == Format::Y4M) {
+            std::fprintf(m_file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", m_size.x, m_size.y, fps);
+        }
+        m_frames_count = 0;
+        return true;
+    }
+
+    [[nodiscard]]
+    bool isOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    void close()
+    {
+        if (m_file) {
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+    /* Pixels are RGBA with rows from the bottom of the frame to its top, as read back from OpenGL.
+       Frames of another size than the stream one are ignored */
+    bool write(const std::vector<sf::Uint8>& pixels, sf::Vector2u size, tp::ThreadPool& thread_pool)
+    {
+        if (!m_file || size != m_size) {
+            return false;
+        }
+        if (m_format == Format::Y4M) {
+            convertToYUV(pixels, thread_pool);
+            std::fputs("FRAME\n", m_file);
+        } else {
+            flipRows(pixels, thread_pool);
+        }
+        const bool success = std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) == m_buffer.size();
+        m_frames_count += success;
+        return success;
+    }
+
+    [[nodiscard]]
+    uint64_t getFramesCount() const
+    {
+        return m_frames_count;
+    }
+
+private:
+    // Each task converts pairs of rows, they share one row of chroma samples
+    void convertToYUV(const std::vector<sf::Uint8>& pixels, tp::ThreadPool& thread_pool)
+    {
+        const uint32_t width         = m_size.x;
+        const uint32_t height        = m_size.y;
+        const uint32_t chroma_width  = (width + 1) / 2;
+        const uint32_t chroma_height = (height + 1) / 2;
+        const std::size_t luma_size   = static_cast<std::size_t>(width) * height;
+        const std::size_t chroma_size = static_cast<std::size_t>(chroma_width) * chroma_height;
+        m_buffer.resize(luma_size + 2 * chroma_size);
+        sf::Uint8* const luma = m_buffer.data();
+        sf::Uint8* const cb   = luma + luma_size;
+        sf::Uint8* const cr   = cb + chroma_size;
+
+        thread_pool.dispatch(chroma_height, [&](uint32_t start, uint32_t end) {
+            for (uint32_t cy{start}; cy < end; ++cy) {
+                for (uint32_t cx{0}; cx < chroma_width; ++cx) {
+                    int32_t r_sum = 0;
+                    int32_t g_sum = 0;
+                    int32_t b_sum = 0;
+                    for (uint32_t dy{0}; dy < 2; ++dy) {
+                        // Borders of odd sizes reuse the last row or column
+                        const uint32_t y = std::min(2 * cy + dy, height - 1);
+                        const sf::Uint8* row = pixels.data() + static_cast<std::size_t>(height - 1 - y) * width * 4;
+                        for (uint32_t dx{0}; dx < 2; ++dx) {
+                            const uint32_t  x = std::min(2 * cx + dx, width - 1);
+                            const int32_t   r = row[4 * x];
+                            const int32_t   g = row[4 * x + 1];
+                            const int32_t   b = row[4 * x + 2];
+                            luma[static_cast<std::size_t>(y) * width + x] = static_cast<sf::Uint8>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                            r_sum += r;
+                            g_sum += g;
+                            b_sum += b;
+                        }
+                    }
+                    const int32_t r = r_sum / 4;
+                    const int32_t g = g_sum / 4;
+                    const int32_t b = b_sum / 4;
+                    const std::size_t i = static_cast<std::size_t>(cy) * chroma_width + cx;
+                    cb[i] = static_cast<sf::Uint8>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                    cr[i] = static_cast<sf::Uint8>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+                }
+            }
+        });
+    }
+
+    void flipRows(const std::vector<sf::Uint8>& pixels, tp::ThreadPool& thread_pool)
+    {
+        const std::size_t row_size = static_cast<std::size_t>(m_size.x) * 4;
+        m_buffer.resize(row_size * m_size.y);
+        thread_pool.dispatch(m_size.y, [&](uint32_t start, uint32_t end) {
+            for (uint32_t y{start}; y < end; ++y) {
+                std::copy_n(pixels.data() + (m_size.y - 1 - y) * row_size, row_size, m_buffer.data() + y * row_size);
+            }
+        });
+    }
+
+    FILE*                  m_file         = nullptr;
+    Format                 m_format       = Format::Y4M;
+    sf::Vector2u           m_size;
+    uint64_t               m_frames_count = 0;
+    std::vector<sf::Uint8> m_buffer;
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include <SFML/Graphics.hpp>
 #include "render/viewport_handler.hpp"
+#include "render/frame_capture.hpp"
+#include "render/video_stream.hpp"
+#include "render/frame_ring.hpp"
 #include "common/event_manager.hpp"
 #include "common/utils.hpp"
 
@@ -10,8 +13,6 @@ class WindowContextHandler;
 
 class RenderContext
 {
-	std::vector<sf::Uint8> img;
-	
 public:
     explicit
     RenderContext(sf::RenderWindow& window)
@@ -39,6 +40,26 @@ public:
     {
         return m_viewport_handler.state.zoom;
     }
+
+    sf::Vector2u getWindowSize() const
+    {
+        return m_window.getSize();
+    }
+
+    // Size of the window view, drawing coordinates keep spanning it when the window is resized
+    sf::Vector2f getViewSize() const
+    {
+        return m_window.getView().getSize();
+    }
+
+    // World area shown in the window
+    sf::FloatRect getViewRect() const
+    {
+        const ViewportHandler::State& state = m_viewport_handler.state;
+        const sf::View&    view     = m_window.getView();
+        const sf::Vector2f top_left = view.getCenter() - view.getSize() / 2.0f;
+        return {state.offset + (top_left - state.center) / state.zoom, view.getSize() / state.zoom};
+    }
     
     void registerCallbacks(sfev::EventManager& event_manager)
     {
@@ -84,17 +105,22 @@ public:
 		m_window.capture().saveToFile(fn);
 	}
 	
-	void save_to_memory()
+	// Queues the frame being drawn to be saved in the background, to be called before display
+	bool capture_display_image(FrameCapture& frame_capture, const std::string& fn)
+	{
+		return frame_capture.capture(m_window, fn);
+	}
+	
+	// RGBA pixels of the frame being drawn, rows from bottom to top, to be called before display
+	void read_display_pixels(std::vector<sf::Uint8>& pixels, sf::Vector2u& size)
 	{
-		std::vector<sf::Uint8> output;
-		m_window.capture().saveToMemory(img, "jpg");
+		FrameCapture::readPixels(m_window, pixels, size);
 	}
 	
-	void save_image_from_memory_to_file(const std::string fn)
+	// Keeps the frame being drawn in the ring, to be called before display
+	void store_display_image(FrameRing& frame_ring, tp::ThreadPool& thread_pool)
 	{
-		sf::Image im;
-		im.loadFromMemory(img.data(), img.size());
-		im.saveToFile(fn);
+		frame_ring.push(m_window, thread_pool);
 	}
 	
     
@@ -0,0 +1,374 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <SFML/System/Clock.hpp>
+#include "mapped_file.hpp"
+#include "physics/physics_nozzle.hpp"
+
+
+/* Binary checkpoint of a PhysicSolverNozzle: parameters, objects with their civ::Vector slots, emitters with
+   their random generator state and geometry. Sections are stored raw at 64 bytes aligned offsets listed in the
+   header, a checkpoint can only be restored by a build with the same objects layout */
+struct CheckpointHeader
+{
+    static constexpr char     magic_value[8] = {'V', 'E', 'R', 'L', 'E', 'T', 'C', 'K'};
+    static constexpr uint32_t current_version = 1;
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t object_size;
+    uint32_t compact_layout;
+    uint32_t emitters_count;
+    uint32_t geometry_points_count;
+    uint32_t padding = 0;
+    uint64_t objects_count;
+    uint64_t slots_count;
+    uint64_t op_count;
+
+    // Solver parameters
+    int32_t  world_width;
+    int32_t  world_height;
+    float    gravity_x;
+    float    gravity_y;
+    uint32_t sub_steps;
+    uint32_t adaptive_sub_steps;
+    float    max_displacement_ratio;
+    uint32_t min_sub_steps;
+    uint32_t max_sub_steps;
+    uint32_t collision_mode;
+    uint32_t periodic_x;
+    uint32_t periodic_y;
+    uint32_t deterministic;
+    uint32_t deterministic_stripe_width;
+    uint32_t sleep_enabled;
+    float    sleep_threshold;
+    uint32_t sleep_delay;
+    uint32_t padding_2 = 0;
+
+    // Sections offsets from the beginning of the file
+    uint64_t objects_offset;
+    uint64_t ids_offset;
+    uint64_t metadata_offset;
+    uint64_t emitters_offset;
+    uint64_t geometry_offset;
+    uint64_t file_size;
+};
+
+
+struct CheckpointEmitter
+{
+    float    inlet_start_x;
+    float    inlet_start_y;
+    float    inlet_end_x;
+    float    inlet_end_y;
+    float    flow_rate;
+    float    velocity_x;
+    float    velocity_y;
+    float    temperature;
+    uint8_t  color[4];
+    uint32_t enabled;
+    float    pending;
+    uint32_t padding = 0;
+    uint64_t seed;
+    uint64_t emitted_count;
+};
+
+
+struct CheckpointPoint
+{
+    float    x;
+    float    y;
+    uint32_t is_wall_follows;
+};
+
+
+static_assert(std::is_trivially_copyable<PhysicObject>::value, "Objects are written and read as raw bytes");
+static_assert(std::is_trivially_copyable<civ::SlotMetadata>::value, "Slots are written and read as raw bytes");
+
+
+// Copy of the solver state taken between two updates, written by a background thread
+struct CheckpointSnapshot
+{
+    CheckpointHeader               header{};
+    std::vector<PhysicObject>      objects;
+    std::vector<uint64_t>          ids;
+    std::vector<civ::SlotMetadata> metadata;
+    std::vector<CheckpointEmitter> emitters;
+    std::vector<CheckpointPoint>   geometry;
+
+    static constexpr uint64_t alignment = 64;
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    void capture(const PhysicSolverNozzle& solver)
+    {
+        const auto& vector = solver.objects;
+        objects.assign(vector.data.begin(), vector.data.begin() + static_cast<int64_t>(vector.data_size));
+        ids      = vector.ids;
+        metadata = vector.metadata;
+
+        emitters.clear();
+        for (const InflowEmitter& emitter : solver.emitters) {
+            CheckpointEmitter record{};
+            record.inlet_start_x = emitter.inlet_start.x;
+            record.inlet_start_y = emitter.inlet_start.y;
+            record.inlet_end_x   = emitter.inlet_end.x;
+            record.inlet_end_y   = emitter.inlet_end.y;
+            record.flow_rate     = emitter.flow_rate;
+            record.velocity_x    = emitter.velocity.x;
+            record.velocity_y    = emitter.velocity.y;
+            record.temperature   = emitter.temperature;
+            record.color[0]      = emitter.color.r;
+            record.color[1]      = emitter.color.g;
+            record.color[2]      = emitter.color.b;
+            record.color[3]      = emitter.color.a;
+            record.enabled       = emitter.enabled;
+            record.pending       = emitter.pending;
+            record.seed          = emitter.seed;
+            record.emitted_count = emitter.emitted_count;
+            emitters.push_back(record);
+        }
+
+        geometry.clear();
+        for (const TPoint& point : solver.g.coords) {
+            geometry.push_back({point.x, point.y, point.isWallFollows});
+        }
+
+        CheckpointHeader& h = header;
+        std::memcpy(h.magic, CheckpointHeader::magic_value, sizeof(h.magic));
+        h.version                    = CheckpointHeader::current_version;
+        h.object_size                = sizeof(PhysicObject);
+#ifdef VERLET_COMPACT_PARTICLES
+        h.compact_layout             = 1;
+#else
+        h.compact_layout             = 0;
+#endif
+        h.emitters_count             = to<uint32_t>(emitters.size());
+        h.geometry_points_count      = to<uint32_t>(geometry.size());
+        h.objects_count              = objects.size();
+        h.slots_count                = ids.size();
+        h.op_count                   = vector.op_count;
+        h.world_width                = solver.grid.width;
+        h.world_height               = solver.grid.height;
+        h.gravity_x                  = solver.gravity.x;
+        h.gravity_y                  = solver.gravity.y;
+        h.sub_steps                  = solver.sub_steps;
+        h.adaptive_sub_steps         = solver.adaptive_sub_steps;
+        h.max_displacement_ratio     = solver.max_displacement_ratio;
+        h.min_sub_steps              = solver.min_sub_steps;
+        h.max_sub_steps              = solver.max_sub_steps;
+        h.collision_mode             = static_cast<uint32_t>(solver.collision_mode);
+        h.periodic_x                 = solver.periodic_x;
+        h.periodic_y                 = solver.periodic_y;
+        h.deterministic              = solver.deterministic;
+        h.deterministic_stripe_width = solver.deterministic_stripe_width;
+        h.sleep_enabled              = solver.sleep_enabled;
+        h.sleep_threshold            = solver.sleep_threshold;
+        h.sleep_delay                = solver.sleep_delay;
+
+        h.objects_offset  = align(sizeof(CheckpointHeader));
+        h.ids_offset      = align(h.objects_offset + objects.size() * sizeof(PhysicObject));
+        h.metadata_offset = align(h.ids_offset + ids.size() * sizeof(uint64_t));
+        h.emitters_offset = align(h.metadata_offset + metadata.size() * sizeof(civ::SlotMetadata));
+        h.geometry_offset = align(h.emitters_offset + emitters.size() * sizeof(CheckpointEmitter));
+        h.file_size       = h.geometry_offset + geometry.size() * sizeof(CheckpointPoint);
+    }
+
+    // The file is written next to its destination and renamed once complete, a crash never leaves a truncated checkpoint
+    [[nodiscard]]
+    bool write(const std::string& path) const
+    {
+        const std::string tmp_path = path + ".tmp";
+        FILE* file = std::fopen(tmp_path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool success = true;
+        const auto write_section = [&](uint64_t offset, const void* data, uint64_t size) {
+            success = success && std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0;
+            success = success && (size == 0 || std::fwrite(data, 1, size, file) == size);
+        };
+        write_section(0, &header, sizeof(header));
+        write_section(header.objects_offset, objects.data(), objects.size() * sizeof(PhysicObject));
+        write_section(header.ids_offset, ids.data(), ids.size() * sizeof(uint64_t));
+        write_section(header.metadata_offset, metadata.data(), metadata.size() * sizeof(civ::SlotMetadata));
+        write_section(header.emitters_offset, emitters.data(), emitters.size() * sizeof(CheckpointEmitter));
+        write_section(header.geometry_offset, geometry.data(), geometry.size() * sizeof(CheckpointPoint));
+        success = (std::fclose(file) == 0) && success;
+        if (!success || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+
+// Saves run in a background thread, the solver is only blocked while the snapshot is copied
+struct CheckpointWriter
+{
+    CheckpointSnapshot snapshot;
+    std::thread        thread;
+    std::atomic<bool>  busy{false};
+    // Results of the last save
+    std::atomic<bool>  success{false};
+    float              capture_time = 0.0f;
+    float              write_time   = 0.0f;
+
+    ~CheckpointWriter()
+    {
+        wait();
+    }
+
+    // Waits for the previous save before taking a new snapshot
+    void save(const PhysicSolverNozzle& solver, const std::string& path)
+    {
+        wait();
+        sf::Clock clock;
+        snapshot.capture(solver);
+        capture_time = PhysicSolver::getElapsedMs(clock);
+        busy = true;
+        thread = std::thread([this, path]() {
+            sf::Clock write_clock;
+            success    = snapshot.write(path);
+            write_time = PhysicSolver::getElapsedMs(write_clock);
+            printf("Checkpoint %s %s (%.1f MB, capture %.1f ms, write %.1f ms)\n", path.c_str(), success ? "saved" : "failed",
+                   to<float>(snapshot.header.file_size) / (1024.0f * 1024.0f), capture_time, write_time);
+            busy = false;
+        });
+    }
+
+    void wait()
+    {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+};
+
+
+/* Restores a checkpoint in a solver created with the same world size, the file is memory mapped
+   and its sections copied in parallel. Returns false, leaving the solver untouched, if the file can't be used */
+inline bool loadCheckpoint(PhysicSolverNozzle& solver, const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        printf("Checkpoint %s: cannot be read\n", path.c_str());
+        return false;
+    }
+    CheckpointHeader h{};
+    if (file.size < sizeof(h)) {
+        printf("Checkpoint %s: truncated\n", path.c_str());
+        return false;
+    }
+    std::memcpy(&h, file.data, sizeof(h));
+    if (std::memcmp(h.magic, CheckpointHeader::magic_value, sizeof(h.magic)) != 0 || h.version != CheckpointHeader::current_version) {
+        printf("Checkpoint %s: not a version %u checkpoint\n", path.c_str(), CheckpointHeader::current_version);
+        return false;
+    }
+#ifdef VERLET_COMPACT_PARTICLES
+    const uint32_t compact_layout = 1;
+#else
+    const uint32_t compact_layout = 0;
+#endif
+    if (h.object_size != sizeof(PhysicObject) || h.compact_layout != compact_layout) {
+        printf("Checkpoint %s: written with a different objects layout\n", path.c_str());
+        return false;
+    }
+    if (h.world_width != solver.grid.width || h.world_height != solver.grid.height) {
+        printf("Checkpoint %s: world size is %dx%d\n", path.c_str(), h.world_width, h.world_height);
+        return false;
+    }
+    // Every section has to be inside the file, checked without overflows since counts come from the file
+    const auto fits = [&](uint64_t offset, uint64_t count, uint64_t element_size) {
+        return offset <= h.file_size && count <= (h.file_size - offset) / element_size;
+    };
+    if (h.file_size > file.size || h.objects_count > h.slots_count ||
+        !fits(h.objects_offset, h.objects_count, sizeof(PhysicObject)) ||
+        !fits(h.ids_offset, h.slots_count, sizeof(uint64_t)) ||
+        !fits(h.metadata_offset, h.slots_count, sizeof(civ::SlotMetadata)) ||
+        !fits(h.emitters_offset, h.emitters_count, sizeof(CheckpointEmitter)) ||
+        !fits(h.geometry_offset, h.geometry_points_count, sizeof(CheckpointPoint))) {
+        printf("Checkpoint %s: truncated\n", path.c_str());
+        return false;
+    }
+    if (h.collision_mode > static_cast<uint32_t>(CollisionMode::Jacobi)) {
+        printf("Checkpoint %s: unknown collision mode %u\n", path.c_str(), h.collision_mode);
+        return false;
+    }
+    // Ids and slots have to map onto each other since both are used as indices once installed
+    const auto* ids      = reinterpret_cast<const uint64_t*>(file.data + h.ids_offset);
+    const auto* metadata = reinterpret_cast<const civ::SlotMetadata*>(file.data + h.metadata_offset);
+    for (uint64_t id{0}; id < h.slots_count; ++id) {
+        if (ids[id] >= h.slots_count || metadata[ids[id]].rid != id) {
+            printf("Checkpoint %s: inconsistent object ids\n", path.c_str());
+            return false;
+        }
+    }
+
+    // Objects
+    auto& objects = solver.objects;
+    objects.data.assign(h.slots_count, PhysicObject{});
+    objects.ids.resize(h.slots_count);
+    objects.metadata.resize(h.slots_count);
+    constexpr uint64_t chunk_size = 1 << 16;
+    const auto* objects_data = reinterpret_cast<const PhysicObject*>(file.data + h.objects_offset);
+    solver.thread_pool.dispatch(to<uint32_t>((h.objects_count + chunk_size - 1) / chunk_size), [&](uint32_t start, uint32_t end) {
+        const uint64_t first = std::min<uint64_t>(start * chunk_size, h.objects_count);
+        const uint64_t last  = std::min<uint64_t>(end * chunk_size, h.objects_count);
+        std::memcpy(objects.data.data() + first, objects_data + first, (last - first) * sizeof(PhysicObject));
+    });
+    std::memcpy(objects.ids.data(), ids, h.slots_count * sizeof(uint64_t));
+    std::memcpy(objects.metadata.data(), metadata, h.slots_count * sizeof(civ::SlotMetadata));
+    objects.data_size = h.objects_count;
+    objects.op_count  = h.op_count;
+
+    // Parameters
+    solver.gravity                    = {h.gravity_x, h.gravity_y};
+    solver.sub_steps                  = h.sub_steps;
+    solver.adaptive_sub_steps         = h.adaptive_sub_steps;
+    solver.max_displacement_ratio     = h.max_displacement_ratio;
+    solver.min_sub_steps              = h.min_sub_steps;
+    solver.max_sub_steps              = h.max_sub_steps;
+    solver.collision_mode             = static_cast<CollisionMode>(h.collision_mode);
+    solver.periodic_x                 = h.periodic_x;
+    solver.periodic_y                 = h.periodic_y;
+    solver.deterministic              = h.deterministic;
+    solver.deterministic_stripe_width = h.deterministic_stripe_width;
+    solver.sleep_enabled              = h.sleep_enabled;
+    solver.sleep_threshold            = h.sleep_threshold;
+    solver.sleep_delay                = h.sleep_delay;
+    solver.wakeAll();
+    solver.removal_flags.assign(objects.size(), 0);
+    solver.removal_count = 0;
+
+    // Emitters
+    const auto* emitters = reinterpret_cast<const CheckpointEmitter*>(file.data + h.emitters_offset);
+    solver.emitters.clear();
+    for (uint32_t i{0}; i < h.emitters_count; ++i) {
+        const CheckpointEmitter& record = emitters[i];
+        InflowEmitter emitter{{record.inlet_start_x, record.inlet_start_y}, {record.inlet_end_x, record.inlet_end_y},
+                              record.flow_rate, {record.velocity_x, record.velocity_y}, record.temperature};
+        emitter.color         = sf::Color{record.color[0], record.color[1], record.color[2], record.color[3]};
+        emitter.enabled       = record.enabled;
+        emitter.pending       = record.pending;
+        emitter.seed          = record.seed;
+        emitter.emitted_count = record.emitted_count;
+        solver.emitters.push_back(emitter);
+    }
+
+    // Geometry
+    const auto* points = reinterpret_cast<const CheckpointPoint*>(file.data + h.geometry_offset);
+    std::vector<TPoint> coords;
+    for (uint32_t i{0}; i < h.geometry_points_count; ++i) {
+        coords.emplace_back(points[i].x, points[i].y, points[i].is_wall_follows != 0);
+    }
+    solver.g = TGeometry(coords);
+    return true;
+}
@@ -0,0 +1,346 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <SFML/System/Clock.hpp>
+#include "mapped_file.hpp"
+#include "physics/physics.hpp"
+
+#ifdef _WIN32
+#include <mutex>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+/* Columnar snapshot layout:
+   header, column descriptors, then the chunks table giving the offset and size of every column of every row
+   group, row group after row group. Chunks follow at 64 bytes aligned offsets, the chunks of a row group being
+   contiguous. Every offset only depends on the rows count, so each row group is serialized and written on its own */
+struct ColumnarHeader
+{
+    static constexpr char     magic_value[8]  = {'V', 'E', 'R', 'L', 'E', 'T', 'C', 'S'};
+    static constexpr uint32_t current_version = 1;
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t columns_count;
+    uint64_t rows_count;
+    uint64_t row_group_size;
+    uint64_t row_groups_count;
+    uint64_t chunks_offset;
+    uint64_t file_size;
+    double   time;
+    float    world_width;
+    float    world_height;
+};
+
+
+enum class ColumnType : uint32_t
+{
+    Float32,
+    UInt64,
+    UInt8,
+};
+
+
+struct ColumnDescriptor
+{
+    char       name[16];
+    ColumnType type;
+    uint32_t   element_size;
+};
+
+
+struct ColumnChunk
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+
+/* Ids, positions, velocities in world units per second and species, the palette index of the object color.
+   Each batch of the thread pool fills its own buffer with whole row groups and writes them with pwrite */
+struct ColumnarSnapshotWriter
+{
+    static constexpr uint64_t alignment = 64;
+
+    enum Column : uint32_t
+    {
+        Id,
+        X,
+        Y,
+        VX,
+        VY,
+        Species,
+        ColumnsCount,
+    };
+
+    uint64_t row_group_size;
+    // Results of the last write
+    float    write_time = 0.0f;
+    uint64_t file_size  = 0;
+
+    explicit
+    ColumnarSnapshotWriter(uint64_t row_group_size_ = 1 << 16)
+        : row_group_size{std::max<uint64_t>(row_group_size_, 1)}
+    {}
+
+    static std::vector<ColumnDescriptor> getColumns()
+    {
+        return {
+            {"id", ColumnType::UInt64, sizeof(uint64_t)},
+            {"x", ColumnType::Float32, sizeof(float)},
+            {"y", ColumnType::Float32, sizeof(float)},
+            {"vx", ColumnType::Float32, sizeof(float)},
+            {"vy", ColumnType::Float32, sizeof(float)},
+            {"species", ColumnType::UInt8, sizeof(uint8_t)},
+        };
+    }
+
+    // Written next to its destination and renamed once complete, like checkpoints
+    bool write(const PhysicSolver& solver, float dt, double time, const std::string& path)
+    {
+        sf::Clock clock;
+        const std::vector<ColumnDescriptor> columns = getColumns();
+        const auto rows_count = to<uint64_t>(solver.objects.size());
+
+        ColumnarHeader header{};
+        std::memcpy(header.magic, ColumnarHeader::magic_value, sizeof(header.magic));
+        header.version          = ColumnarHeader::current_version;
+        header.columns_count    = ColumnsCount;
+        header.rows_count       = rows_count;
+        header.row_group_size   = row_group_size;
+        header.row_groups_count = (rows_count + row_group_size - 1) / row_group_size;
+        header.chunks_offset    = sizeof(ColumnarHeader) + columns.size() * sizeof(ColumnDescriptor);
+        header.time             = time;
+        header.world_width      = solver.world_size.x;
+        header.world_height     = solver.world_size.y;
+
+        // Offsets of every chunk, the largest row group tells the size of the staging buffers
+        std::vector<ColumnChunk> chunks(header.row_groups_count * ColumnsCount);
+        uint64_t offset     = align(header.chunks_offset + chunks.size() * sizeof(ColumnChunk));
+        uint64_t group_span = 0;
+        for (uint64_t group{0}; group < header.row_groups_count; ++group) {
+            const uint64_t rows  = std::min(row_group_size, rows_count - group * row_group_size);
+            const uint64_t start = offset;
+            for (uint32_t c{0}; c < ColumnsCount; ++c) {
+                chunks[group * ColumnsCount + c] = {offset, rows * columns[c].element_size};
+                offset = align(offset + rows * columns[c].element_size);
+            }
+            group_span = std::max(group_span, offset - start);
+        }
+        header.file_size = offset;
+
+        const std::string tmp_path = path + ".tmp";
+        if (!openFile(tmp_path)) {
+            return false;
+        }
+        bool success = writeAt(&header, sizeof(header), 0);
+        success = success && writeAt(columns.data(), columns.size() * sizeof(ColumnDescriptor), sizeof(header));
+        success = success && writeAt(chunks.data(), chunks.size() * sizeof(ColumnChunk), header.chunks_offset);
+
+        const uint32_t batch_count = solver.thread_pool.getBatchCount();
+        batch_buffers.resize(batch_count);
+        std::atomic<bool> failed{!success};
+        const float inv_sub_dt = to<float>(solver.sub_steps) / dt;
+        solver.thread_pool.dispatchIndexed(to<uint32_t>(header.row_groups_count), [&](uint32_t batch, uint32_t start, uint32_t end) {
+            std::vector<uint8_t>& buffer = batch_buffers[batch];
+            buffer.resize(group_span);
+            for (uint32_t group{start}; group < end && !failed; ++group) {
+                const ColumnChunk* group_chunks = &chunks[static_cast<uint64_t>(group) * ColumnsCount];
+                const uint64_t     first        = group * row_group_size;
+                const uint64_t     rows         = std::min(row_group_size, rows_count - first);
+                const uint64_t     base         = group_chunks[0].offset;
+                const auto column = [&](Column c) { return buffer.data() + (group_chunks[c].offset - base); };
+                SpeciesCache species;
+                for (uint64_t r{0}; r < rows; ++r) {
+                    const uint64_t      i   = first + r;
+                    const PhysicObject& obj = solver.objects.data[i];
+                    const Vec2          v   = obj.getVelocity() * inv_sub_dt;
+                    const uint64_t      id  = solver.objects.getID(i);
+                    std::memcpy(column(Id) + r * sizeof(uint64_t), &id, sizeof(uint64_t));
+                    std::memcpy(column(X) + r * sizeof(float), &obj.position.x, sizeof(float));
+                    std::memcpy(column(Y) + r * sizeof(float), &obj.position.y, sizeof(float));
+                    std::memcpy(column(VX) + r * sizeof(float), &v.x, sizeof(float));
+                    std::memcpy(column(VY) + r * sizeof(float), &v.y, sizeof(float));
+                    column(Species)[r] = species.get(obj);
+                }
+                // Chunks are written with their alignment padding, the region of a row group is contiguous
+                const uint64_t span = align(group_chunks[ColumnsCount - 1].offset + group_chunks[ColumnsCount - 1].size) - base;
+                for (uint32_t c{0}; c < ColumnsCount; ++c) {
+                    const uint64_t padding_start = group_chunks[c].offset + group_chunks[c].size - base;
+                    const uint64_t padding_end   = (c + 1 < ColumnsCount) ? group_chunks[c + 1].offset - base : span;
+                    std::memset(buffer.data() + padding_start, 0, padding_end - padding_start);
+                }
+                if (!writeAt(buffer.data(), span, base)) {
+                    failed = true;
+                }
+            }
+        });
+        success = closeFile() && !failed;
+        if (!success || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        file_size  = header.file_size;
+        write_time = PhysicSolver::getElapsedMs(clock);
+        return true;
+    }
+
+private:
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // Palette lookups are a linear search, neighbour objects often share their color
+    struct SpeciesCache
+    {
+        sf::Color color;
+        uint8_t   index = 0;
+        bool      valid = false;
+
+        uint8_t get(const PhysicObject& obj)
+        {
+#ifdef VERLET_COMPACT_PARTICLES
+            return obj.color_index;
+#else
+            if (!valid || obj.color != color) {
+                color = obj.color;
+                index = ColorUtils::getPaletteIndex(color);
+                valid = true;
+            }
+            return index;
+#endif
+        }
+    };
+
+#ifdef _WIN32
+    // No positional writes, batches take turns on a single stream
+    bool openFile(const std::string& path)
+    {
+        file = std::fopen(path.c_str(), "wb");
+        return file != nullptr;
+    }
+
+    bool writeAt(const void* data, uint64_t size, uint64_t offset)
+    {
+        std::lock_guard<std::mutex> lock{file_mutex};
+        return _fseeki64(file, static_cast<int64_t>(offset), SEEK_SET) == 0 && std::fwrite(data, 1, size, file) == size;
+    }
+
+    bool closeFile()
+    {
+        const bool success = std::fclose(file) == 0;
+        file = nullptr;
+        return success;
+    }
+
+    FILE*      file = nullptr;
+    std::mutex file_mutex;
+#else
+    bool openFile(const std::string& path)
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        return fd >= 0;
+    }
+
+    // pwrite may write less than asked, the rest is written from where it stopped
+    bool writeAt(const void* data, uint64_t size, uint64_t offset) const
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        while (size) {
+            const ssize_t written = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+            if (written <= 0) {
+                return false;
+            }
+            bytes  += written;
+            size   -= static_cast<uint64_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+    bool closeFile()
+    {
+        const bool success = ::close(fd) == 0;
+        fd = -1;
+        return success;
+    }
+
+    int fd = -1;
+#endif
+
+    std::vector<std::vector<uint8_t>> batch_buffers;
+};
+
+
+// Memory mapped view of a columnar snapshot, chunks are read in place
+struct ColumnarSnapshotReader
+{
+    MappedFile                    file;
+    ColumnarHeader                header{};
+    std::vector<ColumnDescriptor> columns;
+    const ColumnChunk*            chunks = nullptr;
+
+    bool open(const std::string& path)
+    {
+        if (!file.open(path) || file.size < sizeof(ColumnarHeader)) {
+            return false;
+        }
+        std::memcpy(&header, file.data, sizeof(header));
+        if (std::memcmp(header.magic, ColumnarHeader::magic_value, sizeof(header.magic)) != 0 ||
+            header.version != ColumnarHeader::current_version || header.file_size > file.size || header.file_size < sizeof(header)) {
+            return false;
+        }
+        // Descriptors and chunks table come right after the header, every chunk has to be inside the file
+        if (header.columns_count == 0 || header.columns_count > (header.file_size - sizeof(header)) / sizeof(ColumnDescriptor) ||
+            header.chunks_offset != sizeof(header) + to<uint64_t>(header.columns_count) * sizeof(ColumnDescriptor) ||
+            header.row_groups_count > (header.file_size - header.chunks_offset) / sizeof(ColumnChunk) / header.columns_count) {
+            return false;
+        }
+        columns.resize(header.columns_count);
+        std::memcpy(columns.data(), file.data + sizeof(header), columns.size() * sizeof(ColumnDescriptor));
+        chunks = reinterpret_cast<const ColumnChunk*>(file.data + header.chunks_offset);
+        for (const ColumnDescriptor& column : columns) {
+            if (column.element_size == 0) {
+                return false;
+            }
+        }
+        for (uint64_t i{0}; i < header.row_groups_count * header.columns_count; ++i) {
+            if (chunks[i].offset % ColumnarSnapshotWriter::alignment != 0 || chunks[i].offset > header.file_size ||
+                chunks[i].size > header.file_size - chunks[i].offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Index of a column from its name, columns_count if there is none
+    [[nodiscard]]
+    uint32_t findColumn(const std::string& name) const
+    {
+        for (uint32_t c{0}; c < header.columns_count; ++c) {
+            if (name == std::string(columns[c].name, strnlen(columns[c].name, sizeof(columns[c].name)))) {
+                return c;
+            }
+        }
+        return header.columns_count;
+    }
+
+    // Null with no rows if the chunk does not exist or does not hold values of type T
+    template<typename T>
+    const T* getChunk(uint64_t row_group, uint32_t column, uint64_t& rows) const
+    {
+        rows = 0;
+        if (row_group >= header.row_groups_count || column >= header.columns_count || columns[column].element_size != sizeof(T)) {
+            return nullptr;
+        }
+        const ColumnChunk& chunk = chunks[row_group * header.columns_count + column];
+        rows = chunk.size / columns[column].element_size;
+        return reinterpret_cast<const T*>(file.data + chunk.offset);
+    }
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Read only view of a whole file, memory mapped when the platform allows it and read in memory otherwise
+struct MappedFile
+{
+    const uint8_t*       data = nullptr;
+    uint64_t             size = 0;
+#ifndef _WIN32
+    void*                mapping = nullptr;
+#endif
+    std::vector<uint8_t> buffer;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifndef _WIN32
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info{};
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping stays valid once the descriptor is closed
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+        // Sections are read front to back
+        madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+        mapping = address;
+        data    = static_cast<const uint8_t*>(address);
+        size    = static_cast<uint64_t>(info.st_size);
+        return true;
+#else
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        std::fseek(file, 0, SEEK_END);
+        const long file_size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if (file_size > 0) {
+            buffer.resize(static_cast<uint64_t>(file_size));
+            buffer.resize(std::fread(buffer.data(), 1, buffer.size(), file));
+        }
+        std::fclose(file);
+        data = buffer.data();
+        size = buffer.size();
+        return size > 0;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (mapping) {
+            munmap(mapping, static_cast<size_t>(size));
+            mapping = nullptr;
+        }
+#endif
+        buffer.clear();
+        data = nullptr;
+        size = 0;
+    }
+};
@@ -0,0 +1,323 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <SFML/System/Vector2.hpp>
+#include "engine/common/vec.hpp"
+#include "engine/common/utils.hpp"
+// geometry.hpp relies on the math and vector headers included before it
+#include "physics/geometry.hpp"
+
+
+struct ScenarioProbe
+{
+    std::string name;
+    Vec2        center;
+    float       radius;
+};
+
+/* Setup of a run: geometry, initial conditions, solver and output settings. Defaults are the reference nozzle.
+   Files are made of "key = values" lines grouped in [sections], # starts a comment, see res/scenarios/nozzle.ini */
+struct Scenario
+{
+    // [world]
+    IVec2               world_size = {4000, 350};
+    // Contour of the domain, the face from a point flagged outflow to the next one is open
+    std::vector<TPoint> geometry   = {
+        {0.0f, 0.0f}, {1700.0f, 0.0f}, {2000.0f, 150.0f}, {2200.0f, 150.0f}, {2500.0f, 0.0f}, {4000.0f, 0.0f, false},
+        {4000.0f, 350.0f}, {2500.0f, 350.0f}, {2200.0f, 200.0f}, {2000.0f, 200.0f}, {1700.0f, 350.0f}, {0.0f, 350.0f}
+    };
+    Vec2                gravity    = {0.0f, 0.0f};
+    bool                periodic_x = false;
+    bool                periodic_y = false;
+
+    // [initial] Random positions drawn in the world, those outside of the geometry are discarded
+    uint32_t particle_count      = 100000;
+    uint32_t seed                = 0x13b;
+    // Beyond this abscissa only one position in rarefied_keep_every is kept
+    float    dense_x_max         = 1600.0f;
+    uint32_t rarefied_keep_every = 20;
+    // Displacements per sub step along x, and width of the uniform random displacement on each axis
+    float    bulk_velocity       = 0.0f;
+    float    thermal_velocity    = 0.2f;
+
+    // [inlet]
+    bool  inlet_enabled     = true;
+    Vec2  inlet_start       = {2.0f, 1.0f};
+    Vec2  inlet_end         = {2.0f, 349.0f};
+    float inlet_rate        = 500.0f;
+    Vec2  inlet_velocity    = {20.0f, 0.0f};
+    float inlet_temperature = 770.0f;
+
+    // [solver]
+    uint32_t threads            = 10;
+    uint32_t sub_steps          = 8;
+    bool     adaptive_sub_steps = false;
+    bool     jacobi             = false;
+    bool     deterministic      = false;
+    bool     sleep              = false;
+
+    // [camera] A zoom of 0 fits the world height in 60% of the window, the focus is relative to the world size
+    sf::Vector2u window_size = {1920, 1080};
+    float        zoom        = 0.0f;
+    Vec2         focus       = {0.64f, 0.64f};
+    uint32_t     fps         = 60;
+    // Software renderer of headless runs, objects drawn as single pixels instead of discs
+    bool         point_splats = false;
+
+    // [output]
+    float       field_cell_size      = 10.0f;
+    uint32_t    field_interval       = 30;
+    uint32_t    field_average_window = 20;
+    std::string probes_path          = "probes.csv";
+    uint32_t    probes_interval      = 30;
+    // Bins of the probe line along the centreline, 0 disables it
+    uint32_t    probes_axis_bins     = 200;
+    std::vector<ScenarioProbe> probes = {
+        {"plenum", {800.0f, 175.0f}, 10.0f}, {"throat", {2100.0f, 175.0f}, 10.0f}, {"exit", {2500.0f, 175.0f}, 10.0f}
+    };
+    Vec2        histogram_min        = {700.0f, 100.0f};
+    Vec2        histogram_max        = {900.0f, 250.0f};
+    std::string checkpoint_path      = "nozzle.ckpt";
+    std::string trajectory_path      = "trajectory.bin";
+    uint32_t    trajectory_interval  = 10;
+    bool        trajectory_quantized = true;
+    // Columnar snapshots are written to <snapshot_prefix>_<frame>.vcol
+    std::string snapshot_prefix      = "snapshot";
+    uint32_t    snapshot_row_group   = 1 << 16;
+    // VTK files are written to <vtk_prefix>_<dataset>_<frame>.vtk every vtk_interval frames, 0 only exports on demand
+    std::string vtk_prefix           = "vtk";
+    uint32_t    vtk_interval         = 0;
+    // Headless runs draw a frame to <render_prefix>_<frame>.<render_format> every render_interval frames, png or ppm
+    std::string render_prefix        = "frame";
+    std::string render_format        = "png";
+    uint32_t    render_interval      = 60;
+    // Length of the in memory recording of the last frames, 0 to disable it
+    uint32_t    frame_ring_seconds   = 0;
+
+    bool load(const std::string& path)
+    {
+        std::ifstream file{path};
+        if (!file) {
+            printf("Scenario %s: cannot be read\n", path.c_str());
+            return false;
+        }
+        std::string section;
+        std::string line;
+        uint32_t    line_number    = 0;
+        bool        geometry_reset = false;
+        bool        probes_reset   = false;
+        bool        success        = true;
+        while (std::getline(file, line)) {
+            ++line_number;
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) {
+                continue;
+            }
+            if (line.front() == '[' && line.back() == ']') {
+                section = trim(line.substr(1, line.size() - 2));
+                continue;
+            }
+            const std::size_t equal = line.find('=');
+            if (equal == std::string::npos) {
+                printf("Scenario %s:%u: expected key = values\n", path.c_str(), line_number);
+                success = false;
+                continue;
+            }
+            const std::string key   = section + "." + trim(line.substr(0, equal));
+            const std::string value = trim(line.substr(equal + 1));
+            // Lists given in the file replace the default ones
+            if (key == "world.point" && !geometry_reset) {
+                geometry.clear();
+                geometry_reset = true;
+            } else if (key == "output.probe" && !probes_reset) {
+                probes.clear();
+                probes_reset = true;
+            }
+            const char* error = setValue(key, value);
+            if (error) {
+                printf("Scenario %s:%u: %s '%s'\n", path.c_str(), line_number, error, key.c_str());
+                success = false;
+            }
+        }
+        // Ranges are checked even after a syntax error so that every problem is reported at once
+        return validate(path) && success;
+    }
+
+    // Every value must be read and nothing may follow them, also used for command line values
+    template<typename... TValues>
+    static bool read(const std::string& text, TValues&... values)
+    {
+        std::istringstream stream{text};
+        const bool success = (readValue(stream, values) && ...);
+        stream >> std::ws;
+        return success && stream.eof();
+    }
+
+private:
+    // Returns an error message, or nullptr when the value is set
+    const char* setValue(const std::string& key, const std::string& value)
+    {
+        const char* invalid = "invalid value for";
+        if (key == "world.size")                  { return read(value, world_size.x, world_size.y) ? nullptr : invalid; }
+        if (key == "world.gravity")               { return read(value, gravity.x, gravity.y) ? nullptr : invalid; }
+        if (key == "world.periodic_x")            { return read(value, periodic_x) ? nullptr : invalid; }
+        if (key == "world.periodic_y")            { return read(value, periodic_y) ? nullptr : invalid; }
+        if (key == "world.point")                 { return readPoint(value) ? nullptr : invalid; }
+        if (key == "initial.particle_count")      { return read(value, particle_count) ? nullptr : invalid; }
+        if (key == "initial.seed")                { return read(value, seed) ? nullptr : invalid; }
+        if (key == "initial.dense_x_max")         { return read(value, dense_x_max) ? nullptr : invalid; }
+        if (key == "initial.rarefied_keep_every") { return read(value, rarefied_keep_every) ? nullptr : invalid; }
+        if (key == "initial.bulk_velocity")       { return read(value, bulk_velocity) ? nullptr : invalid; }
+        if (key == "initial.thermal_velocity")    { return read(value, thermal_velocity) ? nullptr : invalid; }
+        if (key == "inlet.enabled")               { return read(value, inlet_enabled) ? nullptr : invalid; }
+        if (key == "inlet.start")                 { return read(value, inlet_start.x, inlet_start.y) ? nullptr : invalid; }
+        if (key == "inlet.end")                   { return read(value, inlet_end.x, inlet_end.y) ? nullptr : invalid; }
+        if (key == "inlet.rate")                  { return read(value, inlet_rate) ? nullptr : invalid; }
+        if (key == "inlet.velocity")              { return read(value, inlet_velocity.x, inlet_velocity.y) ? nullptr : invalid; }
+        if (key == "inlet.temperature")           { return read(value, inlet_temperature) ? nullptr : invalid; }
+        if (key == "solver.threads")              { return read(value, threads) ? nullptr : invalid; }
+        if (key == "solver.sub_steps")            { return read(value, sub_steps) ? nullptr : invalid; }
+        if (key == "solver.adaptive_sub_steps")   { return read(value, adaptive_sub_steps) ? nullptr : invalid; }
+        if (key == "solver.jacobi")               { return read(value, jacobi) ? nullptr : invalid; }
+        if (key == "solver.deterministic")        { return read(value, deterministic) ? nullptr : invalid; }
+        if (key == "solver.sleep")                { return read(value, sleep) ? nullptr : invalid; }
+        if (key == "camera.window_size")          { return read(value, window_size.x, window_size.y) ? nullptr : invalid; }
+        if (key == "camera.zoom")                 { return read(value, zoom) ? nullptr : invalid; }
+        if (key == "camera.focus")                { return read(value, focus.x, focus.y) ? nullptr : invalid; }
+        if (key == "camera.fps")                  { return read(value, fps) ? nullptr : invalid; }
+        if (key == "camera.point_splats")         { return read(value, point_splats) ? nullptr : invalid; }
+        if (key == "output.field_cell_size")      { return read(value, field_cell_size) ? nullptr : invalid; }
+        if (key == "output.field_interval")       { return read(value, field_interval) ? nullptr : invalid; }
+        if (key == "output.field_average_window") { return read(value, field_average_window) ? nullptr : invalid; }
+        if (key == "output.probes_path")          { return read(value, probes_path) ? nullptr : invalid; }
+        if (key == "output.probes_interval")      { return read(value, probes_interval) ? nullptr : invalid; }
+        if (key == "output.probes_axis_bins")     { return read(value, probes_axis_bins) ? nullptr : invalid; }
+        if (key == "output.probe")                { return readProbe(value) ? nullptr : invalid; }
+        if (key == "output.histogram_min")        { return read(value, histogram_min.x, histogram_min.y) ? nullptr : invalid; }
+        if (key == "output.histogram_max")        { return read(value, histogram_max.x, histogram_max.y) ? nullptr : invalid; }
+        if (key == "output.checkpoint_path")      { return read(value, checkpoint_path) ? nullptr : invalid; }
+        if (key == "output.trajectory_path")      { return read(value, trajectory_path) ? nullptr : invalid; }
+        if (key == "output.trajectory_interval")  { return read(value, trajectory_interval) ? nullptr : invalid; }
+        if (key == "output.trajectory_quantized") { return read(value, trajectory_quantized) ? nullptr : invalid; }
+        if (key == "output.snapshot_prefix")      { return read(value, snapshot_prefix) ? nullptr : invalid; }
+        if (key == "output.snapshot_row_group")   { return read(value, snapshot_row_group) ? nullptr : invalid; }
+        if (key == "output.vtk_prefix")           { return read(value, vtk_prefix) ? nullptr : invalid; }
+        if (key == "output.vtk_interval")         { return read(value, vtk_interval) ? nullptr : invalid; }
+        if (key == "output.render_prefix")        { return read(value, render_prefix) ? nullptr : invalid; }
+        if (key == "output.render_format")        { return read(value, render_format) ? nullptr : invalid; }
+        if (key == "output.render_interval")      { return read(value, render_interval) ? nullptr : invalid; }
+        if (key == "output.frame_ring_seconds")   { return read(value, frame_ring_seconds) ? nullptr : invalid; }
+        return "unknown key";
+    }
+
+    // Ranges the simulation can run with, every problem is reported
+    bool validate(const std::string& path) const
+    {
+        bool success = true;
+        const auto check = [&](bool condition, const char* message) {
+            if (!condition) {
+                printf("Scenario %s: %s\n", path.c_str(), message);
+                success = false;
+            }
+        };
+        const auto inside = [&](Vec2 p) {
+            return p.x >= 0.0f && p.y >= 0.0f && p.x <= world_size.x && p.y <= world_size.y;
+        };
+        check(world_size.x >= 4 && world_size.y >= 4, "world size must be at least 4x4");
+        check(geometry.size() >= 3, "geometry needs at least 3 points");
+        for (const TPoint& point : geometry) {
+            check(inside({point.x, point.y}), "geometry point outside of the world");
+        }
+        check(rarefied_keep_every >= 1, "rarefied_keep_every must be at least 1");
+        check(thermal_velocity >= 0.0f, "thermal_velocity must be positive");
+        check(inside(inlet_start) && inside(inlet_end), "inlet outside of the world");
+        check(inlet_rate >= 0.0f && inlet_temperature >= 0.0f, "inlet rate and temperature must be positive");
+        check(threads >= 1 && threads <= 256, "threads must be between 1 and 256");
+        check(sub_steps >= 1, "sub_steps must be at least 1");
+        check(window_size.x > 0 && window_size.y > 0, "window size must not be null");
+        check(zoom >= 0.0f, "zoom must be positive");
+        check(fps >= 1, "fps must be at least 1");
+        check(field_cell_size > 0.0f, "field_cell_size must be positive");
+        check(field_interval >= 1 && field_average_window >= 1, "field interval and average window must be at least 1");
+        check(probes_interval >= 1 && trajectory_interval >= 1, "output intervals must be at least 1");
+        check(snapshot_row_group >= 1, "snapshot_row_group must be at least 1");
+        check(!render_format.empty(), "render_format must not be empty");
+        for (const ScenarioProbe& probe : probes) {
+            check(inside(probe.center) && probe.radius > 0.0f, "probe outside of the world or without radius");
+        }
+        check(inside(histogram_min) && inside(histogram_max) && histogram_min.x < histogram_max.x && histogram_min.y < histogram_max.y,
+              "histogram region must be a non empty rectangle inside the world");
+        return success;
+    }
+
+    // x y, followed by outflow when the face to the next point is open
+    bool readPoint(const std::string& value)
+    {
+        TPoint point;
+        std::string flag;
+        if (!read(value, point.x, point.y) && !(read(value, point.x, point.y, flag) && flag == "outflow")) {
+            return false;
+        }
+        point.isWallFollows = flag.empty();
+        geometry.push_back(point);
+        return true;
+    }
+
+    // name x y radius
+    bool readProbe(const std::string& value)
+    {
+        ScenarioProbe probe;
+        if (!read(value, probe.name, probe.center.x, probe.center.y, probe.radius)) {
+            return false;
+        }
+        probes.push_back(probe);
+        return true;
+    }
+
+    static bool readValue(std::istringstream& stream, float& value)
+    {
+        return static_cast<bool>(stream >> value);
+    }
+
+    static bool readValue(std::istringstream& stream, int32_t& value)
+    {
+        return static_cast<bool>(stream >> value);
+    }
+
+    // Negative numbers are rejected instead of wrapping around
+    static bool readValue(std::istringstream& stream, uint32_t& value)
+    {
+        int64_t number;
+        if (!(stream >> number) || number < 0 || number > UINT32_MAX) {
+            return false;
+        }
+        value = static_cast<uint32_t>(number);
+        return true;
+    }
+
+    static bool readValue(std::istringstream& stream, bool& value)
+    {
+        std::string word;
+        stream >> word;
+        value = word == "true" || word == "on" || word == "1";
+        return value || word == "false" || word == "off" || word == "0";
+    }
+
+    static bool readValue(std::istringstream& stream, std::string& value)
+    {
+        return static_cast<bool>(stream >> value);
+    }
+
+    static std::string trim(const std::string& text)
+    {
+        const std::size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            return {};
+        }
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+};
@@ -0,0 +1,449 @@
+#pragma once
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <SFML/System/Clock.hpp>
+#include "mapped_file.hpp"
+#include "physics/physics.hpp"
+
+
+/* Trajectory file layout:
+   file header, then for each frame a frame header followed by its chunks, each chunk being a chunk header and
+   the ids, x, y, vx and vy arrays of up to chunk_size objects. Closing the file appends the frames index and a
+   footer pointing to it, files left without footer can still be read by walking the frame headers */
+struct TrajectoryFileHeader
+{
+    static constexpr char     magic_value[8]  = {'V', 'E', 'R', 'L', 'E', 'T', 'T', 'R'};
+    static constexpr uint32_t current_version = 1;
+
+    char     magic[8];
+    uint32_t version;
+    // Positions are stored as 16 bits fractions of the world size and velocities as 16 bits fractions of max_velocity
+    uint32_t quantized;
+    float    world_width;
+    float    world_height;
+    float    max_velocity;
+    uint32_t chunk_size;
+};
+
+
+struct TrajectoryFrameHeader
+{
+    uint64_t frame;
+    double   time;
+    uint64_t count;
+    uint64_t chunks_count;
+};
+
+
+struct TrajectoryChunkHeader
+{
+    uint64_t count;
+    uint64_t payload_size;
+};
+
+
+struct TrajectoryIndexEntry
+{
+    uint64_t frame;
+    double   time;
+    uint64_t offset;
+    uint64_t count;
+};
+
+
+struct TrajectoryFooter
+{
+    uint64_t index_offset;
+    uint64_t frames_count;
+    char     magic[8];
+};
+
+
+// Objects state of one frame, velocities in world units per second
+struct TrajectoryFrame
+{
+    uint64_t              frame = 0;
+    double                time  = 0.0;
+    std::vector<uint64_t> ids;
+    std::vector<float>    x;
+    std::vector<float>    y;
+    std::vector<float>    vx;
+    std::vector<float>    vy;
+
+    void resize(uint64_t count)
+    {
+        ids.resize(count);
+        x.resize(count);
+        y.resize(count);
+        vx.resize(count);
+        vy.resize(count);
+    }
+};
+
+
+/* Streams frames to a file from a background thread. Frames are captured in one of two buffers while the
+   other one is written, the solver only waits when the writer is more than one frame late */
+struct TrajectoryWriter
+{
+    std::string              path;
+    FILE*                    file = nullptr;
+    TrajectoryFileHeader     header{};
+    // A frame is captured every interval calls to update
+    uint32_t                 interval;
+    uint32_t                 calls_count = 0;
+    uint64_t                 frame       = 0;
+    double                   time        = 0.0;
+
+    std::array<TrajectoryFrame, 2> buffers;
+    std::array<bool, 2>            pending = {false, false};
+    uint32_t                       capture_buffer = 0;
+    std::mutex                     mutex;
+    std::condition_variable        condition;
+    std::thread                    thread;
+    bool                           stopping = false;
+    std::vector<TrajectoryIndexEntry> index;
+    std::vector<uint8_t>           encoded;
+
+    // Statistics, the solver time is gathered from the updates between captures
+    uint64_t bytes_written  = 0;
+    double   write_seconds  = 0.0;
+    double   capture_ms     = 0.0;
+    double   stall_ms       = 0.0;
+    double   solver_ms      = 0.0;
+
+    TrajectoryWriter(std::string path_, uint32_t interval_, bool quantized, Vec2 world_size, float max_velocity = 500.0f, uint32_t chunk_size = 1 << 16)
+        : path{std::move(path_)}
+        , interval{interval_}
+    {
+        std::memcpy(header.magic, TrajectoryFileHeader::magic_value, sizeof(header.magic));
+        header.version      = TrajectoryFileHeader::current_version;
+        header.quantized    = quantized;
+        header.world_width  = world_size.x;
+        header.world_height = world_size.y;
+        header.max_velocity = max_velocity;
+        header.chunk_size   = chunk_size;
+    }
+
+    ~TrajectoryWriter()
+    {
+        close();
+    }
+
+    bool open()
+    {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        write(&header, sizeof(header));
+        thread = std::thread([this]() { writeLoop(); });
+        return true;
+    }
+
+    [[nodiscard]]
+    bool isOpen() const
+    {
+        return file != nullptr;
+    }
+
+    // To be called once per frame after the solver update
+    void update(const PhysicSolver& solver, float dt)
+    {
+        time      += dt;
+        solver_ms += solver.timings.total;
+        if (++calls_count < interval) {
+            return;
+        }
+        calls_count = 0;
+        capture(solver, dt);
+    }
+
+    void capture(const PhysicSolver& solver, float dt)
+    {
+        if (!file) {
+            return;
+        }
+        sf::Clock clock;
+        TrajectoryFrame& buffer = buffers[capture_buffer];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return !pending[capture_buffer]; });
+        }
+        stall_ms += PhysicSolver::getElapsedMs(clock);
+
+        const float inv_sub_dt = to<float>(solver.sub_steps) / dt;
+        buffer.frame = frame++;
+        buffer.time  = time;
+        buffer.resize(solver.objects.size());
+        solver.thread_pool.dispatch(to<uint32_t>(solver.objects.size()), [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                const PhysicObject& obj = solver.objects.data[i];
+                const Vec2          v   = obj.getVelocity() * inv_sub_dt;
+                buffer.ids[i] = solver.objects.getID(i);
+                buffer.x[i]   = obj.position.x;
+                buffer.y[i]   = obj.position.y;
+                buffer.vx[i]  = v.x;
+                buffer.vy[i]  = v.y;
+            }
+        });
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending[capture_buffer] = true;
+        }
+        condition.notify_all();
+        capture_buffer ^= 1;
+        capture_ms += PhysicSolver::getElapsedMs(clock);
+    }
+
+    // Writes the remaining frames, the index and the footer
+    void close()
+    {
+        if (!file) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        thread.join();
+
+        TrajectoryFooter footer{};
+        footer.index_offset = bytes_written;
+        footer.frames_count = index.size();
+        std::memcpy(footer.magic, TrajectoryFileHeader::magic_value, sizeof(footer.magic));
+        write(index.data(), index.size() * sizeof(TrajectoryIndexEntry));
+        write(&footer, sizeof(footer));
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    // Statistics are updated by the writer thread, they are only complete once closed
+    void printReport() const
+    {
+        const double megabytes = to<double>(bytes_written) / (1024.0 * 1024.0);
+        printf("Trajectory %s: %lu frames, %.1f MB, %.1f MB/s while writing\n", path.c_str(), static_cast<unsigned long>(index.size()),
+               megabytes, write_seconds > 0.0 ? megabytes / write_seconds : 0.0);
+        printf("Solver slowdown: %.2f%% (capture %.1f ms, waiting for the writer %.1f ms, solver %.1f ms)\n",
+               solver_ms > 0.0 ? 100.0 * (capture_ms + stall_ms) / solver_ms : 0.0, capture_ms, stall_ms, solver_ms);
+    }
+
+private:
+    void writeLoop()
+    {
+        uint32_t write_buffer = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() { return pending[write_buffer] || stopping; });
+                if (!pending[write_buffer]) {
+                    return;
+                }
+            }
+            sf::Clock clock;
+            writeFrame(buffers[write_buffer]);
+            write_seconds += clock.getElapsedTime().asSeconds();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending[write_buffer] = false;
+            }
+            condition.notify_all();
+            write_buffer ^= 1;
+        }
+    }
+
+    void writeFrame(const TrajectoryFrame& data)
+    {
+        const uint64_t count        = data.ids.size();
+        const uint64_t chunks_count = (count + header.chunk_size - 1) / header.chunk_size;
+        index.push_back({data.frame, data.time, bytes_written, count});
+        const TrajectoryFrameHeader frame_header{data.frame, data.time, count, chunks_count};
+        write(&frame_header, sizeof(frame_header));
+        for (uint64_t chunk{0}; chunk < chunks_count; ++chunk) {
+            const uint64_t first = chunk * header.chunk_size;
+            const uint64_t size  = std::min<uint64_t>(header.chunk_size, count - first);
+            encodeChunk(data, first, size);
+            const TrajectoryChunkHeader chunk_header{size, encoded.size()};
+            write(&chunk_header, sizeof(chunk_header));
+            write(encoded.data(), encoded.size());
+        }
+        std::fflush(file);
+    }
+
+    void encodeChunk(const TrajectoryFrame& data, uint64_t first, uint64_t count)
+    {
+        encoded.clear();
+        append(data.ids.data() + first, count * sizeof(uint64_t));
+        if (!header.quantized) {
+            for (const std::vector<float>* field : {&data.x, &data.y, &data.vx, &data.vy}) {
+                append(field->data() + first, count * sizeof(float));
+            }
+            return;
+        }
+        appendQuantized(data.x, first, count, 0.0f, header.world_width);
+        appendQuantized(data.y, first, count, 0.0f, header.world_height);
+        appendQuantized(data.vx, first, count, -header.max_velocity, header.max_velocity);
+        appendQuantized(data.vy, first, count, -header.max_velocity, header.max_velocity);
+    }
+
+    void append(const void* data, uint64_t size)
+    {
+        const uint64_t offset = encoded.size();
+        encoded.resize(offset + size);
+        std::memcpy(encoded.data() + offset, data, size);
+    }
+
+    // Values are clamped to [min, max] and mapped on 65536 levels
+    void appendQuantized(const std::vector<float>& values, uint64_t first, uint64_t count, float min, float max)
+    {
+        const uint64_t offset = encoded.size();
+        encoded.resize(offset + count * sizeof(uint16_t));
+        const float scale = 65535.0f / (max - min);
+        for (uint64_t i{0}; i < count; ++i) {
+            const float    value = Math::clamp(values[first + i], min, max);
+            const auto     level = static_cast<uint16_t>((value - min) * scale + 0.5f);
+            std::memcpy(encoded.data() + offset + i * sizeof(uint16_t), &level, sizeof(level));
+        }
+    }
+
+    void write(const void* data, uint64_t size)
+    {
+        if (size) {
+            bytes_written += std::fwrite(data, 1, size, file);
+        }
+    }
+};
+
+
+// Random access to the frames of a trajectory file through its index
+struct TrajectoryReader
+{
+    MappedFile                        file;
+    TrajectoryFileHeader              header{};
+    std::vector<TrajectoryIndexEntry> index;
+
+    bool open(const std::string& path)
+    {
+        if (!file.open(path) || file.size < sizeof(header) + sizeof(TrajectoryFooter)) {
+            return false;
+        }
+        std::memcpy(&header, file.data, sizeof(header));
+        if (std::memcmp(header.magic, TrajectoryFileHeader::magic_value, sizeof(header.magic)) != 0) {
+            return false;
+        }
+        TrajectoryFooter footer{};
+        const uint64_t   data_end = file.size - sizeof(footer);
+        std::memcpy(&footer, file.data + data_end, sizeof(footer));
+        if (std::memcmp(footer.magic, TrajectoryFileHeader::magic_value, sizeof(footer.magic)) == 0) {
+            if (footer.index_offset < sizeof(header) || footer.index_offset > data_end ||
+                footer.frames_count > (data_end - footer.index_offset) / sizeof(TrajectoryIndexEntry)) {
+                return false;
+            }
+            index.resize(footer.frames_count);
+            std::memcpy(index.data(), file.data + footer.index_offset, index.size() * sizeof(TrajectoryIndexEntry));
+            uint64_t frame_end;
+            for (const TrajectoryIndexEntry& entry : index) {
+                if (!checkFrame(entry.offset, footer.index_offset, frame_end)) {
+                    index.clear();
+                    return false;
+                }
+            }
+            return true;
+        }
+        // No index, the file was not closed, frames are kept up to the first incomplete one
+        uint64_t offset = sizeof(header);
+        uint64_t frame_end;
+        while (checkFrame(offset, file.size, frame_end)) {
+            TrajectoryFrameHeader frame_header{};
+            std::memcpy(&frame_header, file.data + offset, sizeof(frame_header));
+            index.push_back({frame_header.frame, frame_header.time, offset, frame_header.count});
+            offset = frame_end;
+        }
+        return true;
+    }
+
+    [[nodiscard]]
+    uint64_t getFramesCount() const
+    {
+        return index.size();
+    }
+
+    void readFrame(uint64_t i, TrajectoryFrame& data) const
+    {
+        const TrajectoryIndexEntry& entry = index[i];
+        TrajectoryFrameHeader frame_header{};
+        std::memcpy(&frame_header, file.data + entry.offset, sizeof(frame_header));
+        data.frame = frame_header.frame;
+        data.time  = frame_header.time;
+        data.resize(frame_header.count);
+        uint64_t offset = entry.offset + sizeof(frame_header);
+        uint64_t first  = 0;
+        for (uint64_t chunk{0}; chunk < frame_header.chunks_count; ++chunk) {
+            TrajectoryChunkHeader chunk_header{};
+            std::memcpy(&chunk_header, file.data + offset, sizeof(chunk_header));
+            const uint8_t* payload = file.data + offset + sizeof(chunk_header);
+            const uint64_t count   = chunk_header.count;
+            std::memcpy(data.ids.data() + first, payload, count * sizeof(uint64_t));
+            payload += count * sizeof(uint64_t);
+            if (header.quantized) {
+                payload = readQuantized(payload, data.x.data() + first, count, 0.0f, header.world_width);
+                payload = readQuantized(payload, data.y.data() + first, count, 0.0f, header.world_height);
+                payload = readQuantized(payload, data.vx.data() + first, count, -header.max_velocity, header.max_velocity);
+                readQuantized(payload, data.vy.data() + first, count, -header.max_velocity, header.max_velocity);
+            } else {
+                for (std::vector<float>* field : {&data.x, &data.y, &data.vx, &data.vy}) {
+                    std::memcpy(field->data() + first, payload, count * sizeof(float));
+                    payload += count * sizeof(float);
+                }
+            }
+            offset += sizeof(chunk_header) + chunk_header.payload_size;
+            first  += count;
+        }
+    }
+
+private:
+    /* True if the frame at offset and all its chunks are within [0, end), and its chunks hold the count objects
+       announced by its header. frame_end is set to the offset following the frame */
+    bool checkFrame(uint64_t offset, uint64_t end, uint64_t& frame_end) const
+    {
+        if (offset > end || end - offset < sizeof(TrajectoryFrameHeader)) {
+            return false;
+        }
+        TrajectoryFrameHeader frame_header{};
+        std::memcpy(&frame_header, file.data + offset, sizeof(frame_header));
+        offset += sizeof(frame_header);
+        const uint64_t row_size = sizeof(uint64_t) + 4 * (header.quantized ? sizeof(uint16_t) : sizeof(float));
+        uint64_t       count    = 0;
+        for (uint64_t chunk{0}; chunk < frame_header.chunks_count; ++chunk) {
+            if (end - offset < sizeof(TrajectoryChunkHeader)) {
+                return false;
+            }
+            TrajectoryChunkHeader chunk_header{};
+            std::memcpy(&chunk_header, file.data + offset, sizeof(chunk_header));
+            offset += sizeof(chunk_header);
+            if (chunk_header.payload_size > end - offset || chunk_header.count > chunk_header.payload_size / row_size ||
+                chunk_header.count > frame_header.count - count) {
+                return false;
+            }
+            offset += chunk_header.payload_size;
+            count  += chunk_header.count;
+        }
+        frame_end = offset;
+        return count == frame_header.count;
+    }
+
+    static const uint8_t* readQuantized(const uint8_t* payload, float* values, uint64_t count, float min, float max)
+    {
+        const float scale = (max - min) / 65535.0f;
+        for (uint64_t i{0}; i < count; ++i) {
+            uint16_t level;
+            std::memcpy(&level, payload + i * sizeof(uint16_t), sizeof(level));
+            values[i] = min + to<float>(level) * scale;
+        }
+        return payload + count * sizeof(uint16_t);
+    }
+};
@@ -0,0 +1,199 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "physics/physics_nozzle.hpp"
+#include "diagnostics/field_sampler.hpp"
+#include "diagnostics/field_average.hpp"
+
+
+/* Binary legacy VTK output, a file holds one dataset. Legacy binary data is big endian, values are produced one by
+   one by a callback and byte swapped through a small fixed staging buffer, so nothing is copied as a whole */
+class VtkStream
+{
+public:
+    VtkStream() = default;
+    VtkStream(const VtkStream&) = delete;
+    VtkStream& operator=(const VtkStream&) = delete;
+
+    ~VtkStream()
+    {
+        close();
+    }
+
+    bool open(const std::string& path, const std::string& title)
+    {
+        close();
+        m_file    = std::fopen(path.c_str(), "wb");
+        m_success = m_file != nullptr;
+        // The title is a single line of at most 256 characters
+        print("# vtk DataFile Version 3.0\n%.255s\nBINARY\n", title.c_str());
+        return m_success;
+    }
+
+    // Returns false if anything failed since open
+    bool close()
+    {
+        if (!m_file) {
+            return false;
+        }
+        flush();
+        m_success = (std::fclose(m_file) == 0) && m_success;
+        m_file    = nullptr;
+        return m_success;
+    }
+
+    template<typename... TArgs>
+    void print(const char* format, TArgs... args)
+    {
+        if (!m_file) {
+            return;
+        }
+        flush();
+        m_success = (std::fprintf(m_file, format, args...) >= 0) && m_success;
+    }
+
+    // Writes count values given by get(i), binary sections end with a new line
+    template<typename T, typename TCallback>
+    void writeValues(uint64_t count, TCallback&& get)
+    {
+        static_assert(sizeof(T) == 4, "VTK values are written as 32 bits words");
+        for (uint64_t i{0}; i < count; ++i) {
+            push(static_cast<T>(get(i)));
+        }
+        flush();
+        print("\n");
+    }
+
+    // Vectors get a null third component
+    template<typename TCallback>
+    void writeVectors(uint64_t count, TCallback&& get)
+    {
+        for (uint64_t i{0}; i < count; ++i) {
+            const Vec2 v = get(i);
+            push(v.x);
+            push(v.y);
+            push(0.0f);
+        }
+        flush();
+        print("\n");
+    }
+
+private:
+    static constexpr uint32_t staging_size = 1 << 14;
+
+    template<typename T>
+    void push(T value)
+    {
+        uint32_t word;
+        std::memcpy(&word, &value, sizeof(word));
+        m_staging[m_staged++] = (word >> 24) | ((word >> 8) & 0xFF00u) | ((word << 8) & 0xFF0000u) | (word << 24);
+        if (m_staged == staging_size) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (m_file && m_staged) {
+            m_success = (std::fwrite(m_staging, sizeof(uint32_t), m_staged, m_file) == m_staged) && m_success;
+        }
+        m_staged = 0;
+    }
+
+    FILE*    m_file    = nullptr;
+    bool     m_success = false;
+    uint32_t m_staged  = 0;
+    uint32_t m_staging[staging_size];
+};
+
+
+// Exports of sampled fields, objects and walls, none of them depends on the window
+struct VtkWriter
+{
+    // Last sample of the sampler as cell data of an image, rows of cells along x
+    static bool writeFields(const std::string& path, const FieldSampler& sampler)
+    {
+        return writeImage(path, sampler,
+            [&](uint32_t i) { return sampler.density[i]; },
+            [&](uint32_t i) { return sampler.velocity[i]; },
+            [&](uint32_t i) { return sampler.temperature[i]; });
+    }
+
+    // Cumulative or rolling averages of the statistics gathered over the sampler cells
+    static bool writeFields(const std::string& path, const FieldSampler& sampler, const FieldStatistics& statistics, bool rolling)
+    {
+        return writeImage(path, sampler,
+            [&](uint32_t i) { return statistics.getDensity(i, rolling); },
+            [&](uint32_t i) { return statistics.getVelocity(i, rolling); },
+            [&](uint32_t i) { return statistics.getTemperature(i, rolling); });
+    }
+
+    // Objects as vertices with their id and velocity in world units per second, dt is the frame duration
+    static bool writeParticles(const std::string& path, const PhysicSolver& solver, float dt)
+    {
+        VtkStream stream;
+        if (!stream.open(path, "objects")) {
+            return false;
+        }
+        const auto  count      = to<uint64_t>(solver.objects.size());
+        const float inv_sub_dt = to<float>(solver.sub_steps) / dt;
+        stream.print("DATASET POLYDATA\nPOINTS %lu float\n", static_cast<unsigned long>(count));
+        stream.writeVectors(count, [&](uint64_t i) { return solver.objects.data[i].position; });
+        stream.print("VERTICES %lu %lu\n", static_cast<unsigned long>(count), static_cast<unsigned long>(2 * count));
+        stream.writeValues<int32_t>(2 * count, [](uint64_t i) { return to<int32_t>(i & 1 ? i / 2 : 1); });
+        stream.print("POINT_DATA %lu\nSCALARS id int 1\nLOOKUP_TABLE default\n", static_cast<unsigned long>(count));
+        stream.writeValues<int32_t>(count, [&](uint64_t i) { return to<int32_t>(solver.objects.getID(i)); });
+        stream.print("VECTORS velocity float\n");
+        stream.writeVectors(count, [&](uint64_t i) { return solver.objects.data[i].getVelocity() * inv_sub_dt; });
+        return stream.close();
+    }
+
+    // One line per face, the wall cell scalar is 0 for open faces
+    static bool writeGeometry(const std::string& path, const TGeometry& geometry)
+    {
+        VtkStream stream;
+        if (!stream.open(path, "geometry")) {
+            return false;
+        }
+        const auto count = to<uint64_t>(geometry.coords.size());
+        stream.print("DATASET POLYDATA\nPOINTS %lu float\n", static_cast<unsigned long>(count));
+        stream.writeVectors(count, [&](uint64_t i) { return Vec2{geometry.coords[i].x, geometry.coords[i].y}; });
+        stream.print("LINES %lu %lu\n", static_cast<unsigned long>(count), static_cast<unsigned long>(3 * count));
+        stream.writeValues<int32_t>(3 * count, [&](uint64_t i) {
+            const auto face = to<int32_t>(i / 3);
+            switch (i % 3) {
+            case 0:  return 2;
+            case 1:  return face;
+            default: return geometry.get_next_idx(face);
+            }
+        });
+        stream.print("CELL_DATA %lu\nSCALARS wall int 1\nLOOKUP_TABLE default\n", static_cast<unsigned long>(count));
+        stream.writeValues<int32_t>(count, [&](uint64_t i) { return to<int32_t>(geometry.coords[i].isWallFollows); });
+        return stream.close();
+    }
+
+private:
+    // Cell values are given by sampler index, VTK walks the cells with x varying fastest
+    template<typename TDensity, typename TVelocity, typename TTemperature>
+    static bool writeImage(const std::string& path, const FieldSampler& sampler, TDensity&& density, TVelocity&& velocity, TTemperature&& temperature)
+    {
+        VtkStream stream;
+        if (!stream.open(path, "fields")) {
+            return false;
+        }
+        const auto count    = to<uint64_t>(sampler.getCellCount());
+        const auto to_index = [&](uint64_t i) {
+            return sampler.getCellIndex(to<int32_t>(i % sampler.size.x), to<int32_t>(i / sampler.size.x));
+        };
+        stream.print("DATASET STRUCTURED_POINTS\nDIMENSIONS %d %d 1\nORIGIN 0 0 0\nSPACING %g %g 1\n",
+                     sampler.size.x + 1, sampler.size.y + 1, sampler.cell_size, sampler.cell_size);
+        stream.print("CELL_DATA %lu\nSCALARS density float 1\nLOOKUP_TABLE default\n", static_cast<unsigned long>(count));
+        stream.writeValues<float>(count, [&](uint64_t i) { return density(to_index(i)); });
+        stream.print("VECTORS velocity float\n");
+        stream.writeVectors(count, [&](uint64_t i) { return velocity(to_index(i)); });
+        stream.print("SCALARS temperature float 1\nLOOKUP_TABLE default\n");
+        stream.writeValues<float>(count, [&](uint64_t i) { return temperature(to_index(i)); });
+        return stream.close();
+    }
+};
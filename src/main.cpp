@@ -1,4 +1,4 @@
-#include <iostream>
+#include <memory>
 
 #include "engine/window_context_handler.hpp"
 #include "engine/common/color_utils.hpp"
@@ -6,68 +6,264 @@
 #include "physics/physics_nozzle.hpp"
 #include "thread_pool/thread_pool.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/software_renderer.hpp"
 
 #include "physics/geometry.hpp"
+#include "physics/memory_report.hpp"
+#include "decomposition/scaling_benchmark.hpp"
+#include "diagnostics/field_average.hpp"
+#include "diagnostics/probes.hpp"
+#include "diagnostics/conservation_monitor.hpp"
+#include "diagnostics/velocity_histogram.hpp"
+#include "io/checkpoint.hpp"
+#include "io/trajectory_writer.hpp"
+#include "io/scenario.hpp"
+#include "io/columnar_snapshot.hpp"
+#include "io/vtk_writer.hpp"
 
 
-int main()
+// Solver settings and inlet of the scenario
+static void configureSolver(PhysicSolverNozzle& solver, const Scenario& scenario)
 {
-	srand(0x13b);
+	solver.gravity            = scenario.gravity;
+	solver.periodic_x         = scenario.periodic_x;
+	solver.periodic_y         = scenario.periodic_y;
+	solver.sub_steps          = scenario.sub_steps;
+	solver.adaptive_sub_steps = scenario.adaptive_sub_steps;
+	solver.collision_mode     = scenario.jacobi ? CollisionMode::Jacobi : CollisionMode::GaussSeidel;
+	solver.deterministic      = scenario.deterministic;
+	solver.sleep_enabled      = scenario.sleep;
+
+	// Inlet on the upstream wall, rate and temperature roughly match the initial plenum gas
+	if (scenario.inlet_enabled) {
+		InflowEmitter inlet{scenario.inlet_start, scenario.inlet_end, scenario.inlet_rate, scenario.inlet_velocity, scenario.inlet_temperature};
+		inlet.color = ColorUtils::getRainbow(0.0f);
+		solver.emitters.push_back(inlet);
+	}
+}
+
+// Initial gas, positions are drawn with rand seeded by the scenario
+static void populate(PhysicSolverNozzle& solver, const Scenario& scenario)
+{
+	const IVec2 world_size = scenario.world_size;
+	for (uint32_t i{scenario.particle_count}; i--;) {
+		auto x = 1 + (float(rand()) / RAND_MAX * (world_size.x - 2));
+		auto y = 1 + (float(rand()) / RAND_MAX * (world_size.y - 2));
+	
+		// Gas ahead of the nozzle
+		if ( ! solver.g.isInside({x,y}) )
+			 continue;
+
+		// Vacuum or rarefied gas in the nozzle and downstream
+		if (x > scenario.dense_x_max && i % scenario.rarefied_keep_every)
+			continue;
+
+		const auto id = solver.createObject({x, y});
+		solver.objects[id].last_position.x -= scenario.bulk_velocity;  // bulk velocity
+		solver.objects[id].last_position.x += scenario.thermal_velocity * (float(rand()) / RAND_MAX - 0.5f); // chaotic speed: 0 -- for hypersonic; considerably greater than bulk velocity -- for ~subsonic
+		solver.objects[id].last_position.y += scenario.thermal_velocity * (float(rand()) / RAND_MAX - 0.5f); //
+		solver.objects[id].setColor(ColorUtils::getRainbow(id * 0.0001f));
+	}
+}
+
+// Run without window: frames are drawn by the software renderer and VTK files written at the scenario intervals
+static int runHeadless(const Scenario& scenario, uint32_t frames_count, const std::string& restart_path)
+{
+	tp::ThreadPool     thread_pool(scenario.threads);
+	PhysicSolverNozzle solver{scenario.world_size, thread_pool, TGeometry{scenario.geometry}};
+	configureSolver(solver, scenario);
+	if (restart_path.empty() || !loadCheckpoint(solver, restart_path)) {
+		populate(solver, scenario);
+	}
+
+	const Vec2 world_size = solver.world_size;
+	SoftwareRenderer renderer{solver, thread_pool, scenario.window_size};
+	renderer.splat = scenario.point_splats ? SoftwareRenderer::Splat::Point : SoftwareRenderer::Splat::Disc;
+	renderer.setZoom(scenario.zoom > 0.0f ? scenario.zoom : to<float>(scenario.window_size.y) / world_size.y * 0.6f);
+	renderer.setFocus({world_size.x * scenario.focus.x, world_size.y * scenario.focus.y});
+	FieldSampler        sampler{world_size, scenario.field_cell_size, scenario.field_interval};
+	ConservationMonitor monitor;
+
+	const float dt = 1.0f / static_cast<float>(scenario.fps);
+	for (uint32_t i{1}; i <= frames_count; ++i) {
+		solver.update(dt);
+		monitor.check(solver.totals);
+		sampler.update(solver, dt);
+		const std::string frame = std::to_string(i);
+		if (scenario.render_interval && i % scenario.render_interval == 0) {
+			renderer.render();
+			const std::string path = scenario.render_prefix + "_" + frame + "." + scenario.render_format;
+			if (!renderer.save(path)) {
+				printf("Cannot write %s\n", path.c_str());
+			}
+		}
+		if (scenario.vtk_interval && i % scenario.vtk_interval == 0) {
+			const std::string suffix = "_" + frame + ".vtk";
+			const bool success = VtkWriter::writeFields(scenario.vtk_prefix + "_fields" + suffix, sampler) &&
+			                     VtkWriter::writeParticles(scenario.vtk_prefix + "_objects" + suffix, solver, dt) &&
+			                     VtkWriter::writeGeometry(scenario.vtk_prefix + "_geometry" + suffix, solver.g);
+			if (!success) {
+				printf("VTK export %s*%s failed\n", scenario.vtk_prefix.c_str(), suffix.c_str());
+			}
+		}
+	}
+	printf("%u frames, %lu objects, alarms: %lu\n", frames_count, static_cast<unsigned long>(solver.objects.size()),
+	       static_cast<unsigned long>(monitor.total_alarms));
+	return 0;
+}
+
+
+static void printUsage(const char* program)
+{
+	printf("Usage: %s [--scenario <file.ini>] [--restart <file>] [--video <file.y4m|file.rgba|->] [--headless <frames>]\n", program);
+	printf("       %s --scaling-benchmark\n", program);
+	printf("  --scenario <file.ini>  geometry, initial conditions, solver and output settings, the reference nozzle otherwise\n");
+	printf("  --restart <file>       start from a checkpoint saved with the K key\n");
+	printf("  --video <file>         frames recorded with Q go to a single uncompressed stream, - for the standard output\n");
+	printf("  --headless <frames>    no window, frames are drawn on the CPU every render_interval frames of the scenario\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	// Headless strong scaling benchmark of the domain decomposition
+	if (argc > 1 && std::string(argv[1]) == "--scaling-benchmark") {
+		dd::runScalingBenchmark({});
+		return 0;
+	}
+	std::string scenario_path;
+	std::string restart_path;
+	std::string video_path;
+	uint32_t    headless_frames = 0;
+	for (int32_t a{1}; a < argc; ++a) {
+		const std::string argument = argv[a];
+		// Every option takes a value
+		const bool known = argument == "--scenario" || argument == "--restart" || argument == "--video" || argument == "--headless";
+		if (!known) {
+			printf("Unknown argument '%s'\n", argument.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+		if (a + 1 == argc) {
+			printf("%s expects a value\n", argument.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+		if (argument == "--scenario") {
+			scenario_path = argv[++a];
+		} else if (argument == "--restart") {
+			restart_path = argv[++a];
+		} else if (argument == "--video") {
+			video_path = argv[++a];
+		} else if (argument == "--headless") {
+			if (!Scenario::read(argv[++a], headless_frames) || !headless_frames) {
+				printf("--headless expects a positive number of frames, got '%s'\n", argv[a]);
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+	}
+
+	Scenario scenario;
+	if (!scenario_path.empty() && !scenario.load(scenario_path)) {
+		return 1;
+	}
+
+	srand(scenario.seed);
+	if (headless_frames) {
+		return runHeadless(scenario, headless_frames, restart_path);
+	}
 	
-    const uint32_t window_width  = 1920;
-    const uint32_t window_height = 1080;
-    WindowContextHandler app("Verlet-MultiThread", sf::Vector2u(window_width, window_height), sf::Style::Default);
+    WindowContextHandler app("Verlet-MultiThread", scenario.window_size, sf::Style::Default);
     RenderContext& render_context = app.getRenderContext();
     // Initialize solver and renderer
 
-    tp::ThreadPool thread_pool(10);
-	const IVec2 world_size{4000, 350};
+    tp::ThreadPool thread_pool(scenario.threads);
+	const IVec2 world_size = scenario.world_size;
 
-	TGeometry g({
-		{0.0f, 0.0f}, {1700.0f, 0.0f}, {2000.0f, 150.0f}, {2200.0f, 150.0f}, {2500.0f, 0.0f}, {4000.0f, 0.0f},
-		{4000.0f, 350.0f}, {2500.0f, 350.0f}, {2200.0f, 200.0f}, {2000.0f, 200.0f}, {1700.0f, 350.0f}, {0.0f, 350.0f}
-	};
-	
-	/* // Just a square box
-	const IVec2 world_size{ 100, 100 };
-	g.coords = { {0.0f, 0.0f}, {100.0f, 0.0f}, {100.0f, 100.0f}, {0.0f, 100.0f} };
-	*/
-    
-	PhysicSolverNozzle solver{world_size, thread_pool, g};
-	solver.gravity = {0.0f, 0.0f};
+	PhysicSolverNozzle solver{world_size, thread_pool, TGeometry{scenario.geometry}};
+	configureSolver(solver, scenario);
+	// Setup, skipped when restarting, before the renderer since the checkpoint replaces the walls
+	if (restart_path.empty() || !loadCheckpoint(solver, restart_path)) {
+		populate(solver, scenario);
+	}
 	
     Renderer renderer(solver, thread_pool);
 
-    const float margin = 0.0f;
-    const auto  zoom   = static_cast<float>(window_height - margin) / static_cast<float>(world_size.y) * 0.6;
+    const float zoom = scenario.zoom > 0.0f ? scenario.zoom : to<float>(scenario.window_size.y) / to<float>(world_size.y) * 0.6f;
     render_context.setZoom(zoom);
-    render_context.setFocus({world_size.x * 0.64f, world_size.y * 0.64f});
-	//render_context.setFocus({ 0.0f, 0.0f });
+    render_context.setFocus({world_size.x * scenario.focus.x, world_size.y * scenario.focus.y});
+
+    // Flow field over coarse cells, 10x10 sampled every half second by default
+    FieldSampler sampler{solver.world_size, scenario.field_cell_size, scenario.field_interval};
+    // Rolling averages over the last samples, about ten seconds by default
+    FieldStatistics statistics{sampler, scenario.field_average_window};
+
+    // Centreline and a few fixed points: plenum, throat and nozzle exit
+    Probes probes{scenario.probes_path, scenario.probes_interval};
+    if (scenario.probes_axis_bins) {
+        probes.addLine(solver, "axis", {2.0f, world_size.y * 0.5f}, {world_size.x - 2.0f, world_size.y * 0.5f}, scenario.probes_axis_bins, 5.0f);
+    }
+    for (const ScenarioProbe& probe : scenario.probes) {
+        probes.addPoint(solver, probe.name, probe.center, probe.radius);
+    }
+
+    // Thermalization check in the plenum
+    auto plenum_histogram = VelocityHistogram::createRectangle(solver, scenario.histogram_min, scenario.histogram_max, 100, 150.0f);
 
     bool emit = true;
     app.getEventManager().addKeyPressedCallback(sf::Keyboard::Space, [&](sfev::CstEv) {
         emit = !emit;
+        for (InflowEmitter& emitter : solver.emitters) {
+            emitter.enabled = emit;
+        }
     });
 
-    constexpr uint32_t fps_cap = 60;
+    const uint32_t fps_cap = scenario.fps;
     int32_t target_fps = fps_cap;
+    app.setFramerateLimit(fps_cap);
     app.getEventManager().addKeyPressedCallback(sf::Keyboard::S, [&](sfev::CstEv) {
         target_fps = target_fps ? 0 : fps_cap;
         app.setFramerateLimit(target_fps);
     });
 	
-	// Save image to memory button
+	// When enabled by the scenario, the last seconds are kept in memory at half resolution and saved as a video with the M key
+	FrameRing frame_ring{app.getWindowSize(), scenario.frame_ring_seconds * fps_cap, 2, FrameRing::Storage::RunLength};
 	app.getEventManager().addKeyPressedCallback(sf::Keyboard::M, [&](sfev::CstEv) {
-        render_context.save_to_memory();
-		printf("Saved to memory!\n");
-		render_context.save_image_from_memory_to_file("b-from_memory.jpg");
-		printf("Saved from memory!\n");
+		if (!frame_ring.getCapacity()) {
+			printf("Frames are not kept in memory, set output.frame_ring_seconds in the scenario\n");
+			return;
+		}
+		printf("Frames in memory: %u (%.1f MB)\n", frame_ring.getCount(), to<float>(frame_ring.getMemoryUsage()) / (1024.0f * 1024.0f));
+		if (frame_ring.saveVideo("last_frames.y4m", fps_cap, thread_pool)) {
+			printf("Saved last_frames.y4m\n");
+		}
     });
 	
-	// Save image from memory to file button
+	// Record frames to pics/, they are encoded by background threads and dropped when those fall behind.
+	// Buffers and encoders are only created when recording starts
 	bool is_saving_pics = false;
+	std::unique_ptr<FrameCapture> frame_capture;
+	// Raw RGBA when the file name ends with .rgba, Y4M otherwise
+	VideoStream video_stream;
+	if (!video_path.empty()) {
+		const bool raw = video_path.size() > 5 && video_path.substr(video_path.size() - 5) == ".rgba";
+		if (!video_stream.open(video_path, raw ? VideoStream::Format::RawRGBA : VideoStream::Format::Y4M, app.getWindowSize(), fps_cap)) {
+			printf("Cannot open video output %s\n", video_path.c_str());
+		}
+	}
+	std::vector<sf::Uint8> video_pixels;
 	app.getEventManager().addKeyPressedCallback(sf::Keyboard::Q, [&](sfev::CstEv) {
 		is_saving_pics = !is_saving_pics;
+		if (is_saving_pics && !video_stream.isOpen() && !frame_capture) {
+			frame_capture = std::make_unique<FrameCapture>(app.getWindowSize(), 16, 4, FrameCapture::Policy::Drop);
+		}
+		if (!is_saving_pics && video_stream.isOpen()) {
+			printf("Video frames written: %lu\n", static_cast<unsigned long>(video_stream.getFramesCount()));
+		} else if (!is_saving_pics) {
+			printf("Frames captured: %lu, dropped: %lu\n", static_cast<unsigned long>(frame_capture->getCapturedCount()),
+			       static_cast<unsigned long>(frame_capture->getDroppedCount()));
+		}
     });
 	
 	// Print frame info
@@ -76,64 +272,163 @@ int main()
 		Vec2 center = render_context.getFocus();
 		printf("zoom: %f\n", zoom);
 		printf("center: %f, %f\n", center.x, center.y);
+		printf("objects: %lu, in view: %u%s\n", static_cast<unsigned long>(solver.objects.size()), renderer.visible_count, renderer.lod_active ? " (density splat)" : "");
+		printf("sub steps: %u%s, max displacement: %f\n", solver.sub_steps, solver.adaptive_sub_steps ? " (adaptive)" : "", solver.max_displacement);
+		printf("update: %.2f ms (grid %.2f, collisions %.2f%s, integration %.2f)\n", solver.timings.total, solver.timings.grid,
+		       solver.timings.collisions, solver.collision_mode == CollisionMode::Jacobi ? " jacobi" : (solver.deterministic ? " deterministic" : ""), solver.timings.integration);
+		printf("field samples: %lu, last sample %.2f ms\n", static_cast<unsigned long>(sampler.sample_count), sampler.last_sample_time);
+		if (solver.sleep_enabled) {
+			printf("sleeping blocks: %u / %lu\n", solver.getSleepingBlocksCount(), static_cast<unsigned long>(solver.block_asleep.size()));
+		}
     });
 
+	// Memory used per object
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::R, [&](sfev::CstEv) {
+		MemoryReport::print(solver);
+	});
+
+	// Toggle deterministic collisions, results do not depend on the thread count anymore
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::D, [&](sfev::CstEv) {
+		solver.deterministic = !solver.deterministic;
+		printf("Deterministic collisions: %s\n", solver.deterministic ? "on" : "off");
+	});
+
+	// Switch between Gauss-Seidel and Jacobi collisions
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::J, [&](sfev::CstEv) {
+		const bool jacobi = solver.collision_mode == CollisionMode::Jacobi;
+		solver.collision_mode = jacobi ? CollisionMode::GaussSeidel : CollisionMode::Jacobi;
+		printf("Collisions: %s\n", jacobi ? "Gauss-Seidel" : "Jacobi");
+	});
+
+	// Toggle adaptive sub stepping
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::A, [&](sfev::CstEv) {
+		solver.adaptive_sub_steps = !solver.adaptive_sub_steps;
+		printf("Adaptive sub steps: %s\n", solver.adaptive_sub_steps ? "on" : "off");
+	});
+
+	// Toggle sleeping of quiescent regions
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::Z, [&](sfev::CstEv) {
+		solver.sleep_enabled = !solver.sleep_enabled;
+		solver.wakeAll();
+		printf("Sleeping: %s\n", solver.sleep_enabled ? "on" : "off");
+	});
+
+	// Restart cumulative averages, once the transient is over for instance
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::C, [&](sfev::CstEv) {
+		statistics.reset();
+		printf("Field averages reset\n");
+	});
+
+	// Export the plenum velocity distributions
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::H, [&](sfev::CstEv) {
+		if (plenum_histogram.exportCSV("plenum_velocities.csv")) {
+			printf("Velocity histograms exported, %lu samples, T = %f\n", static_cast<unsigned long>(plenum_histogram.sample_count), plenum_histogram.getTemperature());
+		}
+	});
+
+	// Save a checkpoint in the background, restart with --restart and its path
+	CheckpointWriter checkpoint_writer;
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::K, [&](sfev::CstEv) {
+		checkpoint_writer.save(solver, scenario.checkpoint_path);
+	});
+
+	// Start or stop recording trajectories, path, interval and quantization come from the scenario
+	std::unique_ptr<TrajectoryWriter> trajectory;
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::T, [&](sfev::CstEv) {
+		if (trajectory) {
+			trajectory->close();
+			trajectory->printReport();
+			trajectory.reset();
+			return;
+		}
+		trajectory = std::make_unique<TrajectoryWriter>(scenario.trajectory_path, scenario.trajectory_interval, scenario.trajectory_quantized, solver.world_size);
+		if (!trajectory->open()) {
+			printf("Cannot open %s\n", scenario.trajectory_path.c_str());
+			trajectory.reset();
+		}
+	});
+
+	// Columnar snapshot of the objects, row groups are written in parallel
+	ColumnarSnapshotWriter snapshot_writer{scenario.snapshot_row_group};
+	int i=0;
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::X, [&](sfev::CstEv) {
+		const float frame_dt = 1.0f / static_cast<float>(fps_cap);
+		const std::string path = scenario.snapshot_prefix + "_" + std::to_string(i) + ".vcol";
+		if (snapshot_writer.write(solver, frame_dt, i * frame_dt, path)) {
+			printf("Snapshot %s (%.1f MB, %.1f ms)\n", path.c_str(), to<float>(snapshot_writer.file_size) / (1024.0f * 1024.0f), snapshot_writer.write_time);
+		} else {
+			printf("Snapshot %s failed\n", path.c_str());
+		}
+	});
+
+	// VTK export of the last field sample, the rolling averages, the objects and the walls
+	const auto export_vtk = [&]() {
+		const std::string suffix = "_" + std::to_string(i) + ".vtk";
+		const bool success = VtkWriter::writeFields(scenario.vtk_prefix + "_fields" + suffix, sampler) &&
+		                     VtkWriter::writeFields(scenario.vtk_prefix + "_averages" + suffix, sampler, statistics, true) &&
+		                     VtkWriter::writeParticles(scenario.vtk_prefix + "_objects" + suffix, solver, 1.0f / static_cast<float>(fps_cap)) &&
+		                     VtkWriter::writeGeometry(scenario.vtk_prefix + "_geometry" + suffix, solver.g);
+		if (!success) {
+			printf("VTK export %s*%s failed\n", scenario.vtk_prefix.c_str(), suffix.c_str());
+		}
+	};
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::V, [&](sfev::CstEv) {
+		export_vtk();
+	});
+
+	// Toggle the density splat used when zoomed out
+	app.getEventManager().addKeyPressedCallback(sf::Keyboard::L, [&](sfev::CstEv) {
+		renderer.lod_enabled = !renderer.lod_enabled;
+		printf("density splat %s\n", renderer.lod_enabled ? "enabled" : "disabled");
+	});
+
 	// Update field
 	app.getEventManager().addKeyPressedCallback(sf::Keyboard::U, [&](sfev::CstEv) {
 		solver.update(1.0f / static_cast<float>(fps_cap));
 	});
 
-	// Who outside
+	// Conservation monitors of the last update
+	ConservationMonitor monitor;
 	app.getEventManager().addKeyPressedCallback(sf::Keyboard::O, [&](sfev::CstEv) {
-		for (auto obj : solver.objects) {
-			TPoint pnt = { obj.position.x, obj.position.y };
-			float isIn = g.isInside(pnt);
-			if (!isIn) {
-				float angleTotal = g._DEBUG_isInsideRetAngle(pnt);
-				std::cout << std::setprecision(19) << pnt.x << " " << pnt.y << ": " << "angleTotal = " << angleTotal << std::endl;
-			}
-		}
+		ConservationMonitor::print(solver.totals);
+		printf("alarms: %lu\n", static_cast<unsigned long>(monitor.total_alarms));
 	});
-	
-	// Setup
-	for (uint32_t i{100000}; i--;) {
-		auto x = 1 + (float(rand()) / RAND_MAX * (world_size.x - 2));
-		auto y = 1 + (float(rand()) / RAND_MAX * (world_size.y - 2));
-		
-		// Gas ahead of the nozzle
-		if ( ! solver.g.isInside({x,y}) )
-			 continue;
-
-		// Vacuum or rarefied gas in the nozzle and downstream
-		if (x > 1600 && i%20)
-			continue;
-
-		const auto id = solver.createObject({x, y});
-		solver.objects[id].last_position.x -= 0.0f;  // bulk velocity
-		solver.objects[id].last_position.x += 0.2f * (float(rand()) / RAND_MAX - 0.5f); // chaotic speed: 0 -- for hypersonic; considerably greater than bulk velocity -- for ~subsonic
-		solver.objects[id].last_position.y += 0.2f * (float(rand()) / RAND_MAX - 0.5f); //
-		solver.objects[id].color = ColorUtils::getRainbow(id * 0.0001f);
-	}
 
     // Main loop
     const float dt = 1.0f / static_cast<float>(fps_cap);
-	int i=0;
     while (app.run()) {
         
 		solver.update(dt);
+		monitor.check(solver.totals);
+		if (sampler.update(solver, dt)) {
+			statistics.addSample(sampler, thread_pool);
+			plenum_histogram.sample(solver, dt);
+		}
+		probes.update(solver, dt);
+		if (trajectory) {
+			trajectory->update(solver, dt);
+		}
+		if (scenario.vtk_interval && (i + 1) % scenario.vtk_interval == 0) {
+			export_vtk();
+		}
 
         render_context.clear();
         renderer.render(render_context);
-        render_context.display();
 
-		
 		++i;
 		
-		if (is_saving_pics){
+		if (is_saving_pics && video_stream.isOpen()) {
+			sf::Vector2u frame_size;
+			render_context.read_display_pixels(video_pixels, frame_size);
+			video_stream.write(video_pixels, frame_size, thread_pool);
+		} else if (is_saving_pics){
 			std::stringstream s;
 			s << "pics/file-" << i << ".jpg";
-			render_context.save_display_image(s.str());
+			render_context.capture_display_image(*frame_capture, s.str());
 		}
+		render_context.store_display_image(frame_ring, thread_pool);
+
+        render_context.display();
 		
 		// TODO:
 		// 1. Evolve to a given time
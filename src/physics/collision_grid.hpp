@@ -51,9 +51,21 @@ struct CollisionGrid : public Grid<CollisionCell>
 		: Grid<CollisionCell>(width, height)
 	{}
 
+	// Cells are stored column by column
+	uint32_t getCellIndex(uint32_t x, uint32_t y) const
+	{
+		return x * height + y;
+	}
+
+	// Coordinates are wrapped around the grid, for periodic boundaries
+	uint32_t getCellIndexWrap(int32_t x, int32_t y) const
+	{
+		return getCellIndex(mod(x, width), mod(y, height));
+	}
+
 	bool addAtom(uint32_t x, uint32_t y, uint32_t atom)
 	{
-		const uint32_t id = x * height + y;
+		const uint32_t id = getCellIndex(x, y);
 		// Add to grid
 		data[id].addAtom(atom);
 		return true;
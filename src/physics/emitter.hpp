@@ -0,0 +1,74 @@
+#pragma once
+#include <SFML/Graphics/Color.hpp>
+#include "physic_object.hpp"
+#include "engine/common/math.hpp"
+#include "engine/common/number_generator.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+
+// Injects objects through an inlet segment at a fixed flow rate
+struct InflowEmitter
+{
+    Vec2      inlet_start;
+    Vec2      inlet_end;
+    // Objects per second
+    float     flow_rate   = 0.0f;
+    // Bulk velocity in world units per second
+    Vec2      velocity    = {0.0f, 0.0f};
+    // Kinetic temperature with unit mass, each velocity component has a standard deviation of sqrt(temperature)
+    float     temperature = 0.0f;
+    sf::Color color       = sf::Color::White;
+    bool      enabled     = true;
+
+    // Fraction of object not emitted yet
+    float     pending       = 0.0f;
+    // Random numbers only depend on the seed and the emitted objects count
+    uint64_t  seed          = 0x13b;
+    uint64_t  emitted_count = 0;
+
+    InflowEmitter() = default;
+
+    InflowEmitter(Vec2 start, Vec2 end, float rate, Vec2 velocity_, float temperature_)
+        : inlet_start{start}
+        , inlet_end{end}
+        , flow_rate{rate}
+        , velocity{velocity_}
+        , temperature{temperature_}
+    {}
+
+    // Emits the objects entering during dt, they are spread over the slab swept by the bulk flow
+    void emit(CIVector<PhysicObject>& objects, tp::ThreadPool& thread_pool, float dt)
+    {
+        if (!enabled) {
+            return;
+        }
+        pending += flow_rate * dt;
+        const auto count = to<uint32_t>(pending);
+        if (!count) {
+            return;
+        }
+        pending -= to<float>(count);
+
+        const uint64_t first        = objects.grow(count);
+        const uint64_t first_number = emitted_count;
+        const float    sigma        = std::sqrt(temperature);
+        thread_pool.dispatch(count, [&](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                const uint64_t n = (first_number + i) * 4;
+                const float along = CounterRNG::get(seed, n);
+                const float depth = CounterRNG::get(seed, n + 1);
+                // Box-Muller, one pair of uniforms gives both velocity components
+                const float radius = std::sqrt(-2.0f * std::log(1.0f - CounterRNG::get(seed, n + 2)));
+                const float angle  = Math::TwoPI * CounterRNG::get(seed, n + 3);
+                const Vec2  v      = velocity + Vec2{std::cos(angle), std::sin(angle)} * (radius * sigma);
+
+                const Vec2 position = inlet_start + (inlet_end - inlet_start) * along + velocity * (depth * dt);
+                PhysicObject& obj = objects.data[first + i];
+                obj.setPosition(position);
+                obj.addVelocity(v * dt);
+                obj.setColor(color);
+            }
+        });
+        emitted_count += count;
+    }
+};
@@ -62,8 +62,8 @@ struct TFace {
 		TPoint toBeg = TPoint(_v1) - mid;
 		TPoint toEnd = TPoint(_v2) - mid;
 		//   90 
-		beg = mid + (isFromNormal ? TPoint({ toBeg.y, -toBeg.x }) : toBeg);
-		end = mid + (isFromNormal ? TPoint({ toEnd.y, -toEnd.x }) : toEnd);
+		beg = mid + (isFromNormal ? TPoint(toBeg.y, -toBeg.x) : toBeg);
+		end = mid + (isFromNormal ? TPoint(toEnd.y, -toEnd.x) : toEnd);
 
 		updateUnitVectors();
 	}
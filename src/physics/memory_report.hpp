@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdio>
+#include "physics.hpp"
+
+
+// Memory used per object by a solver, for both particle layouts (see VERLET_COMPACT_PARTICLES)
+struct MemoryReport
+{
+    static constexpr uint64_t full_object_size    = 3 * sizeof(Vec2) + sizeof(sf::Color);
+    // Position and last position followed by a palette index, padded to the float alignment
+    static constexpr uint64_t compact_object_size = (2 * sizeof(Vec2) + sizeof(uint8_t) + alignof(float) - 1) / alignof(float) * alignof(float);
+#ifdef VERLET_COMPACT_PARTICLES
+    static constexpr bool     compact_build       = true;
+#else
+    static constexpr bool     compact_build       = false;
+#endif
+    static_assert(sizeof(PhysicObject) == (compact_build ? compact_object_size : full_object_size), "Unexpected PhysicObject layout");
+
+    template<typename T>
+    static uint64_t getBytes(const std::vector<T>& v)
+    {
+        return v.capacity() * sizeof(T);
+    }
+
+    static void print(const PhysicSolver& solver)
+    {
+        const auto count = to<double>(std::max<uint64_t>(solver.objects.size(), 1));
+        // Slots allocated for objects, compaction scratch buffer included
+        const uint64_t object_slots = solver.objects.data.capacity() + solver.objects.compact_data.capacity();
+        const uint64_t bookkeeping  = getBytes(solver.objects.ids) + getBytes(solver.objects.metadata) + getBytes(solver.objects.compact_metadata);
+        const uint64_t buffers      = getBytes(solver.removal_flags) + getBytes(solver.new_indices) + getBytes(solver.corrections);
+        const uint64_t grid         = getBytes(solver.grid.data);
+
+        printf("Memory for %lu objects\n", static_cast<unsigned long>(solver.objects.size()));
+        for (const bool compact : {false, true}) {
+            const uint64_t objects = object_slots * (compact ? compact_object_size : full_object_size);
+            const uint64_t total   = objects + bookkeeping + buffers + grid;
+            printf("  %s layout%s: %.1f bytes per object (objects %.1f, ids %.1f, solver buffers %.1f, grid %.1f), %.1f MB\n",
+                   compact ? "compact" : "full", compact == compact_build ? " [current]" : "",
+                   to<double>(total) / count, to<double>(objects) / count, to<double>(bookkeeping) / count,
+                   to<double>(buffers) / count, to<double>(grid) / count, to<double>(total) / (1024.0 * 1024.0));
+        }
+    }
+};
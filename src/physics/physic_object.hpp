@@ -1,5 +1,6 @@
 #pragma once
 #include "collision_grid.hpp"
+#include "engine/common/color_utils.hpp"
 #include "engine/common/utils.hpp"
 #include "engine/common/math.hpp"
 
@@ -9,8 +10,13 @@ struct PhysicObject
     // Verlet
     Vec2 position      = {0.0f, 0.0f};
     Vec2 last_position = {0.0f, 0.0f};
+#ifdef VERLET_COMPACT_PARTICLES
+    // Only uniform accelerations are supported, colors are indexes in the ColorUtils palette
+    uint8_t color_index = 0;
+#else
     Vec2 acceleration  = {0.0f, 0.0f};
     sf::Color color;
+#endif
 
     PhysicObject() = default;
 
@@ -26,16 +32,41 @@ struct PhysicObject
         last_position = pos;
     }
 
-    void update(float dt)
+    // The uniform acceleration is applied on top of the object's own one, gravity for instance
+    void update(float dt, Vec2 uniform_acceleration = {0.0f, 0.0f})
     {
         const Vec2 last_update_move = position - last_position;
 
         const float VELOCITY_DAMPING = 0.0f; // arbitrary, approximating air friction
 
-        const Vec2 new_position = position + last_update_move + (acceleration - last_update_move * VELOCITY_DAMPING) * (dt * dt);
+#ifdef VERLET_COMPACT_PARTICLES
+        const Vec2 total_acceleration = uniform_acceleration;
+#else
+        const Vec2 total_acceleration = acceleration + uniform_acceleration;
+        acceleration = {0.0f, 0.0f};
+#endif
+        const Vec2 new_position = position + last_update_move + (total_acceleration - last_update_move * VELOCITY_DAMPING) * (dt * dt);
         last_position           = position;
         position                = new_position;
-        acceleration = {0.0f, 0.0f};
+    }
+
+    void setColor(sf::Color new_color)
+    {
+#ifdef VERLET_COMPACT_PARTICLES
+        color_index = ColorUtils::getPaletteIndex(new_color);
+#else
+        color = new_color;
+#endif
+    }
+
+    [[nodiscard]]
+    sf::Color getColor() const
+    {
+#ifdef VERLET_COMPACT_PARTICLES
+        return ColorUtils::getPaletteColor(color_index);
+#else
+        return color;
+#endif
     }
 
     void stop()
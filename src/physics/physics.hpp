@@ -1,4 +1,5 @@
 #pragma once
+#include <SFML/System/Clock.hpp>
 #include "collision_grid.hpp"
 #include "physic_object.hpp"
 #include "engine/common/utils.hpp"
@@ -6,6 +7,55 @@
 #include "thread_pool/thread_pool.hpp"
 
 
+enum class CollisionMode
+{
+    // In place contact resolution over grid stripes
+    GaussSeidel,
+    // Corrections gathered from a read only state then applied in one pass
+    Jacobi,
+};
+
+
+// Correction gathered by an object from all its contacts during a Jacobi pass
+struct ContactCorrection
+{
+    Vec2 position = {0.0f, 0.0f};
+    Vec2 velocity = {0.0f, 0.0f};
+};
+
+
+// Totals over the objects integrated during a sub step, with unit mass and velocities in world units per second
+struct ConservationTotals
+{
+    uint64_t count          = 0;
+    double   kinetic_energy = 0.0;
+    double   momentum_x     = 0.0;
+    double   momentum_y     = 0.0;
+    // Objects removed during the whole update, found outside of the geometry or leaving through an outflow
+    uint64_t leaked         = 0;
+    uint64_t outflow        = 0;
+
+    void add(const PhysicObject& obj, float inv_dt)
+    {
+        const Vec2 v = obj.getVelocity() * inv_dt;
+        ++count;
+        kinetic_energy += 0.5 * MathVec2::length2(v);
+        momentum_x     += v.x;
+        momentum_y     += v.y;
+    }
+
+    void merge(const ConservationTotals& other)
+    {
+        count          += other.count;
+        kinetic_energy += other.kinetic_energy;
+        momentum_x     += other.momentum_x;
+        momentum_y     += other.momentum_y;
+        leaked         += other.leaked;
+        outflow        += other.outflow;
+    }
+};
+
+
 struct PhysicSolver
 {
     CIVector<PhysicObject> objects;
@@ -17,23 +67,82 @@ struct PhysicSolver
     uint32_t        sub_steps;
     tp::ThreadPool& thread_pool;
 
+    // Adaptive sub stepping, the sub steps count is chosen each frame from the fastest object
+    bool     adaptive_sub_steps     = false;
+    // Allowed displacement per sub step, as a fraction of the smallest of particle radius and cell size
+    float    max_displacement_ratio = 0.5f;
+    uint32_t min_sub_steps          = 2;
+    uint32_t max_sub_steps          = 32;
+    // Largest displacement per sub step measured at the beginning of the last update
+    float    max_displacement       = 0.0f;
+
+    CollisionMode                  collision_mode = CollisionMode::GaussSeidel;
+    std::vector<ContactCorrection> corrections;
+
+    // Periodic boundaries, objects leaving the world on one side come back on the other one
+    bool periodic_x = false;
+    bool periodic_y = false;
+
+    // Results are bitwise identical whatever the thread count, collisions use stripes of fixed width
+    bool     deterministic              = false;
+    uint32_t deterministic_stripe_width = 16;
+
+    // Conservation monitors, gathered by each batch of the integration sweep and merged after it
+    std::vector<ConservationTotals> batch_totals;
+    ConservationTotals              totals;
+
+    // Time spent in each phase during the last update, in milliseconds
+    struct Timings
+    {
+        float grid        = 0.0f;
+        float collisions  = 0.0f;
+        float integration = 0.0f;
+        float total       = 0.0f;
+    } timings;
+
+    static constexpr float particle_radius = 0.5f;
+    static constexpr float cell_size       = 1.0f;
+
+    // Sleeping, blocks of cells where no object moves are skipped by collisions and integration
+    bool     sleep_enabled   = false;
+    // Displacement per sub step under which an object is considered at rest
+    float    sleep_threshold = 0.005f;
+    // Quiet sub steps before a block falls asleep
+    uint32_t sleep_delay     = 32;
+    static constexpr int32_t sleep_block_size = 8;
+
+    IVec2                             sleep_blocks_size;
+    std::vector<uint8_t>              block_asleep;
+    std::vector<uint32_t>             block_quiet_steps;
+    // Set by worker threads when something moves in a block or touches it, cleared every sub step
+    std::vector<std::atomic<uint8_t>> block_active;
+
+    // Objects flagged for removal during the current sub step, indexed like objects.data
+    std::vector<uint8_t>  removal_flags;
+    std::atomic<uint32_t> removal_count = 0;
+    std::vector<uint32_t> new_indices;
+
     PhysicSolver(IVec2 size, tp::ThreadPool& tp)
         : grid{size.x, size.y}
         , world_size{to<float>(size.x), to<float>(size.y)}
         , sub_steps{8}
         , thread_pool{tp}
+        , sleep_blocks_size{(size.x + sleep_block_size - 1) / sleep_block_size, (size.y + sleep_block_size - 1) / sleep_block_size}
+        , block_asleep(sleep_blocks_size.x * sleep_blocks_size.y, 0)
+        , block_quiet_steps(sleep_blocks_size.x * sleep_blocks_size.y, 0)
+        , block_active(sleep_blocks_size.x * sleep_blocks_size.y)
     {
         grid.clear();
     }
 
-    // Checks if two atoms are colliding and if so create a new contact
-    virtual void solveContact(uint32_t atom_1_idx, uint32_t atom_2_idx)
+    // Checks if two atoms are colliding and if so create a new contact, returns true if they were
+    virtual bool solveContact(uint32_t atom_1_idx, uint32_t atom_2_idx)
     {
         constexpr float response_coef = 1.0f;
         constexpr float eps           = 0.0001f;
         PhysicObject& obj_1 = objects.data[atom_1_idx];
         PhysicObject& obj_2 = objects.data[atom_2_idx];
-        const Vec2 o2_o1  = obj_1.position - obj_2.position;
+        const Vec2 o2_o1  = getMinimumImage(obj_1.position - obj_2.position);
         const float dist2 = o2_o1.x * o2_o1.x + o2_o1.y * o2_o1.y;
         if (dist2 < 1.0f && dist2 > eps) {
             const float dist          = sqrt(dist2);
@@ -42,32 +151,129 @@ struct PhysicSolver
             const Vec2 col_vec = (o2_o1 / dist) * delta;
             obj_1.position += col_vec;
             obj_2.position -= col_vec;
+            return true;
+        }
+        return false;
+    }
+
+    // Same as solveContact but only computes the correction of the first atom, objects are not modified
+    virtual bool accumulateContact(uint32_t atom_1_idx, uint32_t atom_2_idx, ContactCorrection& correction) const
+    {
+        constexpr float response_coef = 1.0f;
+        constexpr float eps           = 0.0001f;
+        const PhysicObject& obj_1 = objects.data[atom_1_idx];
+        const PhysicObject& obj_2 = objects.data[atom_2_idx];
+        const Vec2 o2_o1  = getMinimumImage(obj_1.position - obj_2.position);
+        const float dist2 = o2_o1.x * o2_o1.x + o2_o1.y * o2_o1.y;
+        if (dist2 < 1.0f && dist2 > eps) {
+            const float dist   = sqrt(dist2);
+            const float delta  = response_coef * 0.5f * (1.0f - dist);
+            const Vec2 col_vec = (o2_o1 / dist) * delta;
+            // Moving the position alone also changes the Verlet velocity
+            correction.position += col_vec;
+            correction.velocity += col_vec;
+            return true;
         }
+        return false;
     }
 
-    void checkAtomCellCollisions(uint32_t atom_idx, const CollisionCell& c)
+    static void applyCorrection(PhysicObject& obj, const ContactCorrection& correction)
     {
+        obj.position      += correction.position;
+        obj.last_position += correction.position - correction.velocity;
+    }
+
+    void checkAtomCellCollisions(uint32_t atom_idx, uint32_t cell_index)
+    {
+        const CollisionCell& c = grid.data[cell_index];
+        bool contact = false;
         for (uint32_t i{0}; i < c.objects_count; ++i) {
-            solveContact(atom_idx, c.objects[i]);
+            contact |= solveContact(atom_idx, c.objects[i]);
+        }
+        // Objects of a sleeping block hit by an awake one wake their block up
+        if (contact && sleep_enabled) {
+            wakeBlock(getCellBlockIndex(cell_index));
         }
     }
 
     void processCell(const CollisionCell& c, uint32_t index)
     {
+        if (sleep_enabled && block_asleep[getCellBlockIndex(index)]) {
+            return;
+        }
+        if (periodic_x || periodic_y) {
+            processCellWrap(c, index);
+            return;
+        }
+        for (uint32_t i{0}; i < c.objects_count; ++i) {
+            const uint32_t atom_idx = c.objects[i];
+            checkAtomCellCollisions(atom_idx, index - 1);
+            checkAtomCellCollisions(atom_idx, index);
+            checkAtomCellCollisions(atom_idx, index + 1);
+            checkAtomCellCollisions(atom_idx, index + grid.height - 1);
+            checkAtomCellCollisions(atom_idx, index + grid.height    );
+            checkAtomCellCollisions(atom_idx, index + grid.height + 1);
+            checkAtomCellCollisions(atom_idx, index - grid.height - 1);
+            checkAtomCellCollisions(atom_idx, index - grid.height    );
+            checkAtomCellCollisions(atom_idx, index - grid.height + 1);
+        }
+    }
+
+    // Neighbour cells are looked up with wrapped coordinates
+    void processCellWrap(const CollisionCell& c, uint32_t index)
+    {
+        const auto x = to<int32_t>(index / grid.height);
+        const auto y = to<int32_t>(index % grid.height);
         for (uint32_t i{0}; i < c.objects_count; ++i) {
             const uint32_t atom_idx = c.objects[i];
-            checkAtomCellCollisions(atom_idx, grid.data[index - 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + grid.height - 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + grid.height    ]);
-            checkAtomCellCollisions(atom_idx, grid.data[index + grid.height + 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index - grid.height - 1]);
-            checkAtomCellCollisions(atom_idx, grid.data[index - grid.height    ]);
-            checkAtomCellCollisions(atom_idx, grid.data[index - grid.height + 1]);
+            for (int32_t dx{-1}; dx <= 1; ++dx) {
+                for (int32_t dy{-1}; dy <= 1; ++dy) {
+                    checkAtomCellCollisions(atom_idx, getNeighbourIndex(x + dx, y + dy));
+                }
+            }
+        }
+    }
+
+    // Wrapping has no effect on non periodic axes, the grid safety border keeps their neighbours in range
+    uint32_t getNeighbourIndex(int32_t x, int32_t y) const
+    {
+        return grid.getCellIndexWrap(x, y);
+    }
+
+    // Shortest vector between two periodic images
+    Vec2 getMinimumImage(Vec2 v) const
+    {
+        if (periodic_x) {
+            v.x -= world_size.x * std::round(v.x / world_size.x);
+        }
+        if (periodic_y) {
+            v.y -= world_size.y * std::round(v.y / world_size.y);
+        }
+        return v;
+    }
+
+    void applyPeriodicBoundaries(PhysicObject& obj) const
+    {
+        if (periodic_x) {
+            wrapCoordinate(obj.position.x, obj.last_position.x, world_size.x);
+        }
+        if (periodic_y) {
+            wrapCoordinate(obj.position.y, obj.last_position.y, world_size.y);
         }
     }
 
+    // Brings the position in [0, size), the last position is moved along to keep the velocity
+    static void wrapCoordinate(float& position, float& last_position, float size)
+    {
+        float shift = size * std::floor(position / size);
+        // Rounding can land exactly on size
+        if (position - shift >= size) {
+            shift += size;
+        }
+        position      -= shift;
+        last_position -= shift;
+    }
+
     void solveCollisionThreaded(uint32_t start, uint32_t end)
     {
         for (uint32_t idx{start}; idx < end; ++idx) {
@@ -78,37 +284,174 @@ struct PhysicSolver
     // Find colliding atoms
     void solveCollisions()
     {
-        // Multi-thread grid
-        const uint32_t thread_count = thread_pool.m_thread_count;
-        const uint32_t slice_count  = thread_count * 2;
-        const uint32_t slice_size   = (grid.width / slice_count) * grid.height;
-        const uint32_t last_cell    = (2 * (thread_count - 1) + 2) * slice_size;
-        // Find collisions in two passes to avoid data races
-
-        // First collision pass
-        for (uint32_t i{0}; i < thread_count; ++i) {
-            thread_pool.addTask([this, i, slice_size]{
-                uint32_t const start{2 * i * slice_size};
-                uint32_t const end  {start + slice_size};
-                solveCollisionThreaded(start, end);
-            });
+        if (collision_mode == CollisionMode::Jacobi) {
+            solveCollisionsJacobi();
+            return;
         }
-        // Eventually process rest if the world is not divisible by the thread count
-        if (last_cell < grid.data.size()) {
-            thread_pool.addTask([this, last_cell]{
-                solveCollisionThreaded(last_cell, to<uint32_t>(grid.data.size()));
-            });
+        // A fixed tiling makes the contacts order independent of the thread count
+        const uint32_t stripe_width = deterministic ? deterministic_stripe_width
+                                                    : grid.width / (thread_pool.m_thread_count * 2);
+        solveCollisionStripes(std::max(stripe_width, 2u));
+    }
+
+    /* Grid columns are split in stripes, even stripes are processed first and then odd ones.
+       Stripes need to be at least 2 cells wide so that two stripes of the same pass never share objects */
+    void solveCollisionStripes(uint32_t stripe_width)
+    {
+        const auto width = to<uint32_t>(grid.width);
+        uint32_t stripe_count = (width + stripe_width - 1) / stripe_width;
+        // With periodic boundaries the last stripe also touches the first one
+        bool isolate_last = false;
+        if (periodic_x && stripe_count > 1) {
+            // A narrow last stripe would let its two neighbours share objects, merge it
+            if (width - (stripe_count - 1) * stripe_width < 2) {
+                --stripe_count;
+            }
+            isolate_last = stripe_count % 2;
         }
-        thread_pool.waitForCompletion();
-        // Second collision pass
-        for (uint32_t i{0}; i < thread_count; ++i) {
-            thread_pool.addTask([this, i, slice_size]{
-                uint32_t const start{(2 * i + 1) * slice_size};
-                uint32_t const end  {start + slice_size};
-                solveCollisionThreaded(start, end);
+        const auto process_stripe = [&](uint32_t stripe) {
+            const uint32_t start = stripe * stripe_width;
+            const uint32_t end   = (stripe == stripe_count - 1) ? width : start + stripe_width;
+            solveCollisionThreaded(start * grid.height, end * grid.height);
+        };
+        const uint32_t paired_count = stripe_count - isolate_last;
+        for (uint32_t pass{0}; pass < 2; ++pass) {
+            const uint32_t pass_stripe_count = (paired_count + 1 - pass) / 2;
+            thread_pool.dispatch(pass_stripe_count, [&](uint32_t start, uint32_t end){
+                for (uint32_t i{start}; i < end; ++i) {
+                    process_stripe(2 * i + pass);
+                }
             });
         }
-        thread_pool.waitForCompletion();
+        if (isolate_last) {
+            process_stripe(stripe_count - 1);
+        }
+    }
+
+    // No writes to neighbours, so objects can be processed in any order without synchronization
+    void solveCollisionsJacobi()
+    {
+        const auto object_count = to<uint32_t>(objects.size());
+        corrections.resize(object_count);
+        thread_pool.dispatch(object_count, [this](uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                corrections[i] = {};
+                const Vec2 position = objects.data[i].position;
+                if (!isInGrid(position)) {
+                    continue;
+                }
+                const auto x = to<int32_t>(position.x);
+                const auto y = to<int32_t>(position.y);
+                const uint32_t index = grid.getCellIndex(x, y);
+                if (sleep_enabled && block_asleep[getCellBlockIndex(index)]) {
+                    continue;
+                }
+                // Objects dropped by a full cell are not seen by their neighbours, skip them to keep contacts symmetric
+                const CollisionCell& cell = grid.data[index];
+                if (std::find(cell.objects, cell.objects + cell.objects_count, i) == cell.objects + cell.objects_count) {
+                    continue;
+                }
+                for (int32_t dx{-1}; dx <= 1; ++dx) {
+                    for (int32_t dy{-1}; dy <= 1; ++dy) {
+                        const uint32_t       neighbour_index = getNeighbourIndex(x + dx, y + dy);
+                        const CollisionCell& neighbour       = grid.data[neighbour_index];
+                        bool contact = false;
+                        for (uint32_t k{0}; k < neighbour.objects_count; ++k) {
+                            if (neighbour.objects[k] != i) {
+                                contact |= accumulateContact(i, neighbour.objects[k], corrections[i]);
+                            }
+                        }
+                        // Sleeping objects do not gather their side of the contact, wake them up for the next sub step
+                        if (contact && sleep_enabled) {
+                            wakeBlock(getCellBlockIndex(neighbour_index));
+                        }
+                    }
+                }
+            }
+        });
+        thread_pool.dispatch(object_count, [this](uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                applyCorrection(objects.data[i], corrections[i]);
+            }
+        });
+    }
+
+    uint32_t getCellBlockIndex(uint32_t cell_index) const
+    {
+        const auto x = to<int32_t>(cell_index / grid.height);
+        const auto y = to<int32_t>(cell_index % grid.height);
+        return to<uint32_t>((x / sleep_block_size) * sleep_blocks_size.y + y / sleep_block_size);
+    }
+
+    uint32_t getBlockIndex(Vec2 position) const
+    {
+        const int32_t x = std::clamp(to<int32_t>(position.x), 0, grid.width - 1);
+        const int32_t y = std::clamp(to<int32_t>(position.y), 0, grid.height - 1);
+        return to<uint32_t>((x / sleep_block_size) * sleep_blocks_size.y + y / sleep_block_size);
+    }
+
+    void wakeBlock(uint32_t block)
+    {
+        if (block_asleep[block]) {
+            block_active[block].store(1, std::memory_order_relaxed);
+        }
+    }
+
+    // True if the object rests in a sleeping block and does not need to be integrated, fast intruders wake the block up
+    bool skipSleeping(const PhysicObject& obj)
+    {
+        if (!sleep_enabled) {
+            return false;
+        }
+        const uint32_t block = getBlockIndex(obj.position);
+        if (!block_asleep[block]) {
+            return false;
+        }
+        if (MathVec2::length2(obj.getVelocity()) < sleep_threshold * sleep_threshold) {
+            return true;
+        }
+        block_active[block].store(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Called after integration, a moving object keeps its block awake
+    void recordMotion(const PhysicObject& obj)
+    {
+        if (sleep_enabled && MathVec2::length2(obj.getVelocity()) >= sleep_threshold * sleep_threshold) {
+            block_active[getBlockIndex(obj.position)].store(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Active blocks are woken up, the others fall asleep after sleep_delay quiet sub steps
+    void updateSleepingBlocks()
+    {
+        thread_pool.dispatch(to<uint32_t>(block_asleep.size()), [this](uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                if (block_active[i].load(std::memory_order_relaxed)) {
+                    block_active[i].store(0, std::memory_order_relaxed);
+                    block_asleep[i]      = 0;
+                    block_quiet_steps[i] = 0;
+                } else if (!block_asleep[i] && ++block_quiet_steps[i] >= sleep_delay) {
+                    block_asleep[i] = 1;
+                }
+            }
+        });
+    }
+
+    // Has to be called when sleeping is toggled, objects may have moved since blocks fell asleep
+    void wakeAll()
+    {
+        std::fill(block_asleep.begin(), block_asleep.end(), 0);
+        std::fill(block_quiet_steps.begin(), block_quiet_steps.end(), 0);
+        for (std::atomic<uint8_t>& active : block_active) {
+            active.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]]
+    uint32_t getSleepingBlocksCount() const
+    {
+        return to<uint32_t>(std::count(block_asleep.begin(), block_asleep.end(), 1));
     }
 
     // Add a new object to the solver
@@ -125,51 +468,194 @@ struct PhysicSolver
 
     void update(float dt)
     {
+        sf::Clock total_clock;
+        sf::Clock clock;
+        timings = {};
+        totals  = {};
+        if (adaptive_sub_steps) {
+            updateSubSteps();
+        }
         // Perform the sub steps
         const float sub_dt = dt / static_cast<float>(sub_steps);
         for (uint32_t i(sub_steps); i--;) {
+            clock.restart();
             addObjectsToGrid();
+            timings.grid += getElapsedMs(clock);
             solveCollisions();
+            timings.collisions += getElapsedMs(clock);
+            removal_flags.resize(objects.size(), 0);
             updateObjects_multi(sub_dt);
+            timings.integration += getElapsedMs(clock);
+            if (sleep_enabled) {
+                updateSleepingBlocks();
+            }
+            removeMarkedObjects();
+            injectObjects(sub_dt);
         }
+        timings.total = getElapsedMs(total_clock);
+    }
+
+    static float getElapsedMs(sf::Clock& clock)
+    {
+        return to<float>(clock.restart().asMicroseconds()) * 0.001f;
+    }
+
+    // Called at the end of each sub step to add new objects
+    virtual void injectObjects(float)
+    {
+    }
+
+    // Flags an object to be removed at the end of the sub step, can be called from integration threads
+    void markForRemoval(uint32_t i)
+    {
+        removal_flags[i] = 1;
+        ++removal_count;
+    }
+
+    // Removes flagged objects and remaps the grid to the compacted indices
+    void removeMarkedObjects()
+    {
+        if (removal_count == 0) {
+            return;
+        }
+        const auto dispatch = [this](uint32_t count, auto&& callback) {
+            thread_pool.dispatch(count, callback);
+        };
+        new_indices.resize(objects.size());
+        objects.compact(removal_flags, dispatch, [this](uint64_t old_idx, uint64_t new_idx) {
+            new_indices[old_idx] = to<uint32_t>(new_idx);
+        });
+        thread_pool.dispatch(to<uint32_t>(grid.data.size()), [this](uint32_t start, uint32_t end) {
+            for (uint32_t i{start}; i < end; ++i) {
+                CollisionCell& cell = grid.data[i];
+                uint32_t kept = 0;
+                for (uint32_t k{0}; k < cell.objects_count; ++k) {
+                    const uint32_t atom = cell.objects[k];
+                    if (!removal_flags[atom]) {
+                        cell.objects[kept++] = new_indices[atom];
+                    }
+                }
+                cell.objects_count = kept;
+            }
+        });
+        std::fill(removal_flags.begin(), removal_flags.end(), 0);
+        removal_count = 0;
+    }
+
+    // Largest distance traveled by an object during the last sub step
+    float computeMaxDisplacement()
+    {
+        std::vector<float> batch_max(thread_pool.getBatchCount(), 0.0f);
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch, uint32_t start, uint32_t end){
+            float max_dist2 = 0.0f;
+            for (uint32_t i{start}; i < end; ++i) {
+                max_dist2 = std::max(max_dist2, MathVec2::length2(objects.data[i].getVelocity()));
+            }
+            batch_max[batch] = max_dist2;
+        });
+        return sqrt(*std::max_element(batch_max.begin(), batch_max.end()));
+    }
+
+    // Picks the smallest sub steps count keeping displacements under the allowed fraction of radius and cell size
+    void updateSubSteps()
+    {
+        max_displacement = computeMaxDisplacement();
+        // Distance covered during a whole frame does not depend on the current sub steps count
+        const float frame_displacement = max_displacement * to<float>(sub_steps);
+        const float max_step           = max_displacement_ratio * std::min(particle_radius, cell_size);
+        const auto  required           = to<uint32_t>(std::ceil(frame_displacement / max_step));
+        setSubSteps(std::min(std::max(required, min_sub_steps), max_sub_steps));
+    }
+
+    // Changes the sub steps count, Verlet velocities are rescaled to keep physical speeds unchanged
+    void setSubSteps(uint32_t count)
+    {
+        if (count == sub_steps) {
+            return;
+        }
+        const float ratio = to<float>(sub_steps) / to<float>(count);
+        thread_pool.dispatch(to<uint32_t>(objects.size()), [&](uint32_t start, uint32_t end){
+            for (uint32_t i{start}; i < end; ++i) {
+                PhysicObject& obj = objects.data[i];
+                obj.last_position = obj.position - obj.getVelocity() * ratio;
+            }
+        });
+        sub_steps = count;
     }
 
     void addObjectsToGrid()
     {
         grid.clear();
+        // Objects are inserted in data order, keeping the contacts order inside cells stable
         // Safety border to avoid adding object outside the grid
         uint32_t i{0};
-        for (const PhysicObject& obj : objects.data) {
-            if (obj.position.x > 1.0f && obj.position.x < world_size.x - 1.0f &&
-                obj.position.y > 1.0f && obj.position.y < world_size.y - 1.0f) {
+        for (const PhysicObject& obj : objects) {
+            if (isInGrid(obj.position)) {
                 grid.addAtom(to<int32_t>(obj.position.x), to<int32_t>(obj.position.y), i);
             }
             ++i;
         }
     }
 
+    bool isInGrid(Vec2 position) const
+    {
+        return isInGrid(position.x, world_size.x, periodic_x) && isInGrid(position.y, world_size.y, periodic_y);
+    }
+
+    // Periodic axes use the whole grid since neighbours are wrapped, the others keep the safety border
+    static bool isInGrid(float coord, float size, bool periodic)
+    {
+        return periodic ? (coord >= 0.0f && coord < size) : (coord > 1.0f && coord < size - 1.0f);
+    }
+
+    // Counts, energy and momentum come from the last sub step, removals add up over the whole update
+    void mergeBatchTotals()
+    {
+        ConservationTotals sum;
+        for (const ConservationTotals& batch_total : batch_totals) {
+            sum.merge(batch_total);
+        }
+        sum.leaked  += totals.leaked;
+        sum.outflow += totals.outflow;
+        totals = sum;
+    }
+
     virtual void updateObjects_multi(float dt)
     {
-        thread_pool.dispatch(to<uint32_t>(objects.size()), [&](uint32_t start, uint32_t end){
+        const float inv_dt = 1.0f / dt;
+        batch_totals.resize(thread_pool.getBatchCount());
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch, uint32_t start, uint32_t end){
+            ConservationTotals& batch_total = batch_totals[batch];
+            batch_total = {};
             for (uint32_t i{start}; i < end; ++i) {
                 PhysicObject& obj = objects.data[i];
-                // Add gravity
-                obj.acceleration += gravity;
-                // Apply Verlet integration
-                obj.update(dt);
+                if (skipSleeping(obj)) {
+                    batch_total.add(obj, inv_dt);
+                    continue;
+                }
+                // Add gravity and apply Verlet integration
+                obj.update(dt, gravity);
+                applyPeriodicBoundaries(obj);
+                recordMotion(obj);
                 // Apply map borders collisions
                 const float margin = 2.0f;
-                if (obj.position.x > world_size.x - margin) {
-                    obj.position.x = world_size.x - margin;
-                } else if (obj.position.x < margin) {
-                    obj.position.x = margin;
+                if (!periodic_x) {
+                    if (obj.position.x > world_size.x - margin) {
+                        obj.position.x = world_size.x - margin;
+                    } else if (obj.position.x < margin) {
+                        obj.position.x = margin;
+                    }
                 }
-                if (obj.position.y > world_size.y - margin) {
-                    obj.position.y = world_size.y - margin;
-                } else if (obj.position.y < margin) {
-                    obj.position.y = margin;
+                if (!periodic_y) {
+                    if (obj.position.y > world_size.y - margin) {
+                        obj.position.y = world_size.y - margin;
+                    } else if (obj.position.y < margin) {
+                        obj.position.y = margin;
+                    }
                 }
+                batch_total.add(obj, inv_dt);
             }
         });
+        mergeBatchTotals();
     }
 };
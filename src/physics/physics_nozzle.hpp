@@ -2,11 +2,13 @@
 
 #include "physics.hpp"
 #include "geometry.hpp"
+#include "emitter.hpp"
 
 
 struct PhysicSolverNozzle : PhysicSolver
 {
 	TGeometry g;
+	std::vector<InflowEmitter> emitters;
 
     PhysicSolverNozzle(IVec2 size, tp::ThreadPool& tp, TGeometry _g ) : PhysicSolver(size, tp), g(_g) { ; }
 	
@@ -23,7 +25,9 @@ struct PhysicSolverNozzle : PhysicSolver
 		PhysicObject& obj_1 = objects.data[atom_1_idx];
         PhysicObject& obj_2 = objects.data[atom_2_idx];
 
-		TFace face = { obj_1.position, obj_2.position, true };
+		// Periodic image of the second atom closest to the first one
+		const Vec2 position_2 = obj_1.position - getMinimumImage(obj_1.position - obj_2.position);
+		TFace face = { obj_1.position, position_2, true };
 
 		Vec2 v1 = obj_1.getVelocity();
 		Vec2 v2 = obj_2.getVelocity();
@@ -42,13 +46,13 @@ struct PhysicSolverNozzle : PhysicSolver
 	
 	// Checks if two atoms are colliding and if so create a new contact
 	// Overloads base class functionality
-    void solveContact(uint32_t atom_1_idx, uint32_t atom_2_idx) override
+    bool solveContact(uint32_t atom_1_idx, uint32_t atom_2_idx) override
     {
         constexpr float response_coef = 1.0f;
         constexpr float eps           = 0.0001f;
         PhysicObject& obj_1 = objects.data[atom_1_idx];
         PhysicObject& obj_2 = objects.data[atom_2_idx];
-        const Vec2 o2_o1  = obj_1.position - obj_2.position;
+        const Vec2 o2_o1  = getMinimumImage(obj_1.position - obj_2.position);
         const float dist2 = o2_o1.x * o2_o1.x + o2_o1.y * o2_o1.y;
         if (dist2 < 1.0f && dist2 > eps) {
             const float dist          = sqrt(dist2);
@@ -61,38 +65,86 @@ struct PhysicSolverNozzle : PhysicSolver
             obj_2.last_position -= col_vec;
 			
 			exchangeVelocities(atom_1_idx, atom_2_idx);
+			return true;
         }
+        return false;
     }
 	
+	// Jacobi counterpart of solveContact, the normal velocity exchange is seen from the first atom only
+	// Overloads base class functionality
+	bool accumulateContact(uint32_t atom_1_idx, uint32_t atom_2_idx, ContactCorrection& correction) const override
+	{
+		constexpr float response_coef = 1.0f;
+		constexpr float eps           = 0.0001f;
+		const PhysicObject& obj_1 = objects.data[atom_1_idx];
+		const PhysicObject& obj_2 = objects.data[atom_2_idx];
+		const Vec2 o2_o1  = getMinimumImage(obj_1.position - obj_2.position);
+		const float dist2 = o2_o1.x * o2_o1.x + o2_o1.y * o2_o1.y;
+		if (dist2 < 1.0f && dist2 > eps) {
+			const float dist   = sqrt(dist2);
+			const Vec2  normal = o2_o1 / dist;
+			const float delta  = response_coef * 0.5f * (1.0f - dist);
+			correction.position += normal * delta;
+			correction.velocity += normal * MathVec2::dot(normal, obj_2.getVelocity() - obj_1.getVelocity());
+			return true;
+		}
+		return false;
+	}
+
+	// Overloads base class functionality
+	void injectObjects(float dt) override
+	{
+		for (InflowEmitter& emitter : emitters) {
+			emitter.emit(objects, thread_pool, dt);
+		}
+	}
+
 	// Overloads base class functionality
 	void updateObjects_multi(float dt) override
     {
-        thread_pool.dispatch(to<uint32_t>(objects.size()), [&](uint32_t start, uint32_t end){
+        const float inv_dt = 1.0f / dt;
+        batch_totals.resize(thread_pool.getBatchCount());
+        thread_pool.dispatchIndexed(to<uint32_t>(objects.size()), [&](uint32_t batch, uint32_t start, uint32_t end){
+            ConservationTotals& batch_total = batch_totals[batch];
+            batch_total = {};
             for (uint32_t i{start}; i < end; ++i) {
                 PhysicObject& obj = objects.data[i];
-                // Add gravity
-                obj.acceleration += gravity;
-                // Apply Verlet integration
-                obj.update(dt);
-				
+				if (skipSleeping(obj)) {
+					batch_total.add(obj, inv_dt);
+					continue;
+				}
+                // Add gravity and apply Verlet integration
+                obj.update(dt, gravity);
+				applyPeriodicBoundaries(obj);
+				recordMotion(obj);
 
 				// Geometry boundaries
 				const TPoint pnt = { obj.position.x, obj.position.y };
 				const TPoint pnt_prev = { obj.last_position.x, obj.last_position.y };
 
 				
-				if ( g.isInside(pnt) )
+				if ( g.isInside(pnt) ) {
+					batch_total.add(obj, inv_dt);
 					continue;
+				}
+				// Already outside before this step, the object leaked out of the geometry
 				if (!g.isInside(pnt_prev)) {
-					//removeObject(obj);
-					//++cnt;
-					//std::cout << "Removed: " << cnt << std::endl;
+					markForRemoval(i);
+					++batch_total.leaked;
 					continue;
 				}
 
 				const TFace& face = g.getClosestFace(pnt);
+				// Outflow boundary
+				if (!face.isWall) {
+					markForRemoval(i);
+					++batch_total.outflow;
+					continue;
+				}
 				reflect(obj, face);
+				batch_total.add(obj, inv_dt);
             }
         });
+        mergeBatchTotals();
     }
 };
@@ -23,8 +23,15 @@ void Renderer::render(RenderContext& context)
     states.texture = &object_texture;
     context.draw(world_va, states);
     // Particles
-    updateParticlesVA();
-    context.draw(objects_va, states);
+    const sf::FloatRect view = context.getViewRect();
+    lod_active = useDensitySplat(context.getZoom());
+    if (lod_active) {
+        updateDensityTexture(view, context.getViewSize());
+        context.drawDirect(density_sprite);
+    } else {
+        updateParticlesVA(view);
+        context.draw(objects_va, states);
+    }
 }
 
 void Renderer::initializeWorldVA()
@@ -43,16 +50,45 @@ void Renderer::initializeWorldVA()
 	}
 }
 
-void Renderer::updateParticlesVA()
+void Renderer::updateParticlesVA(const sf::FloatRect& view)
 {
-    objects_va.resize(solver.objects.size() * 4);
-
     const float texture_size = 1024.0f;
     const float radius       = 0.5f;
-    thread_pool.dispatch(to<uint32_t>(solver.objects.size()), [&](uint32_t start, uint32_t end) {
+    const float min_x = view.left - radius;
+    const float min_y = view.top - radius;
+    const float max_x = view.left + view.width + radius;
+    const float max_y = view.top + view.height + radius;
+    const auto is_visible = [&](const PhysicObject& object) {
+        return object.position.x > min_x && object.position.x < max_x && object.position.y > min_y && object.position.y < max_y;
+    };
+
+    // Visible objects of each batch
+    const auto object_count = to<uint32_t>(solver.objects.size());
+    batch_visible_counts.resize(thread_pool.getBatchCount());
+    thread_pool.dispatchIndexed(object_count, [&](uint32_t batch, uint32_t start, uint32_t end) {
+        uint32_t count = 0;
+        for (uint32_t i{start}; i < end; ++i) {
+            count += is_visible(solver.objects.data[i]);
+        }
+        batch_visible_counts[batch] = count;
+    });
+    // Counts become the first vertex quad of each batch
+    visible_count = 0;
+    for (uint32_t& count : batch_visible_counts) {
+        const uint32_t batch_offset = visible_count;
+        visible_count += count;
+        count = batch_offset;
+    }
+    objects_va.resize(static_cast<std::size_t>(visible_count) * 4);
+
+    thread_pool.dispatchIndexed(object_count, [&](uint32_t batch, uint32_t start, uint32_t end) {
+        uint32_t quad = batch_visible_counts[batch];
         for (uint32_t i{start}; i < end; ++i) {
             const PhysicObject& object = solver.objects.data[i];
-            const uint32_t idx = i << 2;
+            if (!is_visible(object)) {
+                continue;
+            }
+            const uint32_t idx = quad++ << 2;
             objects_va[idx + 0].position = object.position + Vec2{-radius, -radius};
             objects_va[idx + 1].position = object.position + Vec2{ radius, -radius};
             objects_va[idx + 2].position = object.position + Vec2{ radius,  radius};
@@ -62,7 +98,7 @@ void Renderer::updateParticlesVA()
             objects_va[idx + 2].texCoords = {texture_size, texture_size};
             objects_va[idx + 3].texCoords = {0.0f        , texture_size};
 
-            const sf::Color color = object.color;
+            const sf::Color color = object.getColor();
             objects_va[idx + 0].color = color;
             objects_va[idx + 1].color = color;
             objects_va[idx + 2].color = color;
@@ -71,6 +107,73 @@ void Renderer::updateParticlesVA()
     });
 }
 
+bool Renderer::useDensitySplat(float zoom) const
+{
+    // Objects have a unit diameter, a packed region holds 1 / zoom^2 of them per pixel
+    return lod_enabled && zoom > 0.0f && 1.0f / (zoom * zoom) > lod_threshold;
+}
+
+void Renderer::updateDensityTexture(const sf::FloatRect& view, sf::Vector2f view_size)
+{
+    // One pixel per view unit, the sprite is drawn in view coordinates and stretched with it
+    const sf::Vector2u size{std::max(1u, to<uint32_t>(view_size.x)), std::max(1u, to<uint32_t>(view_size.y))};
+    const std::size_t  pixel_count = static_cast<std::size_t>(size.x) * size.y;
+    if (density_texture.getSize() != size) {
+        density_texture.create(size.x, size.y);
+        density_sprite.setTexture(density_texture, true);
+        density_accumulation = std::vector<std::atomic<uint32_t>>(pixel_count * 4);
+        density_pixels.resize(pixel_count * 4);
+    }
+    density_sprite.setScale(view_size.x / to<float>(size.x), view_size.y / to<float>(size.y));
+
+    // Splat, objects are few per pixel so atomics rarely contend
+    const float scale_x = to<float>(size.x) / view.width;
+    const float scale_y = to<float>(size.y) / view.height;
+    std::atomic<uint32_t> splatted{0};
+    thread_pool.dispatch(to<uint32_t>(solver.objects.size()), [&](uint32_t start, uint32_t end) {
+        uint32_t count = 0;
+        for (uint32_t i{start}; i < end; ++i) {
+            const PhysicObject& object = solver.objects.data[i];
+            const float x = (object.position.x - view.left) * scale_x;
+            const float y = (object.position.y - view.top) * scale_y;
+            if (x < 0.0f || y < 0.0f || x >= to<float>(size.x) || y >= to<float>(size.y)) {
+                continue;
+            }
+            const std::size_t pixel = (static_cast<std::size_t>(y) * size.x + static_cast<std::size_t>(x)) * 4;
+            const sf::Color   color = object.getColor();
+            density_accumulation[pixel + 0].fetch_add(1, std::memory_order_relaxed);
+            density_accumulation[pixel + 1].fetch_add(color.r, std::memory_order_relaxed);
+            density_accumulation[pixel + 2].fetch_add(color.g, std::memory_order_relaxed);
+            density_accumulation[pixel + 3].fetch_add(color.b, std::memory_order_relaxed);
+            ++count;
+        }
+        splatted.fetch_add(count, std::memory_order_relaxed);
+    });
+    visible_count = splatted;
+
+    /* Resolve, the color is the mean of the pixel objects and the opacity their coverage: each one covers
+       a disc of the object radius in pixels, overlapping at random */
+    const float object_area = Math::PI * 0.25f * scale_x * scale_y;
+    thread_pool.dispatch(to<uint32_t>(size.y), [&](uint32_t start, uint32_t end) {
+        for (std::size_t pixel{start * static_cast<std::size_t>(size.x)}; pixel < end * static_cast<std::size_t>(size.x); ++pixel) {
+            std::atomic<uint32_t>* sums  = &density_accumulation[pixel * 4];
+            sf::Uint8*             out   = &density_pixels[pixel * 4];
+            const uint32_t         count = sums[0].load(std::memory_order_relaxed);
+            if (!count) {
+                out[3] = 0;
+                continue;
+            }
+            for (uint32_t c{0}; c < 3; ++c) {
+                out[c] = static_cast<sf::Uint8>(sums[c + 1].load(std::memory_order_relaxed) / count);
+                sums[c + 1].store(0, std::memory_order_relaxed);
+            }
+            sums[0].store(0, std::memory_order_relaxed);
+            out[3] = static_cast<sf::Uint8>(255.0f * (1.0f - std::exp(-object_area * to<float>(count))));
+        }
+    });
+    density_texture.update(density_pixels.data());
+}
+
 void Renderer::renderHUD(RenderContext&)
 {
     // HUD
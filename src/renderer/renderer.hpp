@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <vector>
 #include <SFML/Graphics.hpp>
 #include "physics/physics_nozzle.hpp"
 #include "engine/window_context_handler.hpp"
@@ -14,6 +16,22 @@ struct Renderer
 
     tp::ThreadPool& thread_pool;
 
+    // Objects in view during the last frame, counted per batch to place their vertices
+    std::vector<uint32_t> batch_visible_counts;
+    uint32_t              visible_count = 0;
+
+    /* Level of detail: when objects get smaller than pixels they are splatted in a screen sized buffer
+       accumulating their count and colors, drawn as one fullscreen texture instead of a quad per object */
+    bool  lod_enabled   = true;
+    // Objects per pixel of a packed region above which the splat is used, 1 when objects are one pixel wide
+    float lod_threshold = 1.0f;
+    bool  lod_active    = false;
+    // Count, red, green and blue sums of each pixel, zeroed again when resolved
+    std::vector<std::atomic<uint32_t>> density_accumulation;
+    std::vector<sf::Uint8>             density_pixels;
+    sf::Texture                        density_texture;
+    sf::Sprite                         density_sprite;
+
     explicit
     Renderer(PhysicSolverNozzle& solver_, tp::ThreadPool& tp);
 
@@ -21,7 +39,12 @@ struct Renderer
 
     void initializeWorldVA();
 
-    void updateParticlesVA();
+    // Only objects overlapping the view get vertices, packed without holes
+    void updateParticlesVA(const sf::FloatRect& view);
+
+    bool useDensitySplat(float zoom) const;
+
+    void updateDensityTexture(const sf::FloatRect& view, sf::Vector2f view_size);
 
     void renderHUD(RenderContext& context);
 };
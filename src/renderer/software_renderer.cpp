@@ -0,0 +1,246 @@
+#include "software_renderer.hpp"
+#include <algorithm>
+#include <cstdio>
+
+
+SoftwareRenderer::SoftwareRenderer(PhysicSolverNozzle& solver_, tp::ThreadPool& tp, sf::Vector2u size_)
+    : solver{solver_}
+    , thread_pool{tp}
+    , size{size_}
+    , viewport{{to<float>(size_.x), to<float>(size_.y)}}
+    , pixels(static_cast<std::size_t>(size_.x) * size_.y * 4)
+    , tiles{(to<int32_t>(size_.x) + tile_size - 1) / tile_size, (to<int32_t>(size_.y) + tile_size - 1) / tile_size}
+    , tile_start(tiles.x * tiles.y + 1, 0)
+{
+    // Same contour as the window one
+    TGeometry geometry = solver.g;
+    outline = geometry.getCoordsInflated(0.5f);
+}
+
+void SoftwareRenderer::setZoom(float zoom)
+{
+    viewport.setZoom(zoom);
+}
+
+void SoftwareRenderer::setFocus(Vec2 focus)
+{
+    viewport.setFocus(focus);
+}
+
+void SoftwareRenderer::render()
+{
+    binObjects();
+    thread_pool.dispatch(to<uint32_t>(tiles.x * tiles.y), [&](uint32_t start, uint32_t end) {
+        for (uint32_t i{start}; i < end; ++i) {
+            renderTile(to<int32_t>(i) % tiles.x, to<int32_t>(i) / tiles.x);
+        }
+    });
+}
+
+bool SoftwareRenderer::save(const std::string& path) const
+{
+    if (path.size() < 4 || path.substr(path.size() - 4) != ".ppm") {
+        sf::Image image;
+        image.create(size.x, size.y, pixels.data());
+        return image.saveToFile(path);
+    }
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool success = std::fprintf(file, "P6\n%u %u\n255\n", size.x, size.y) > 0;
+    std::vector<sf::Uint8> row(static_cast<std::size_t>(size.x) * 3);
+    for (uint32_t y{0}; y < size.y && success; ++y) {
+        const sf::Uint8* source = pixels.data() + static_cast<std::size_t>(y) * size.x * 4;
+        for (uint32_t x{0}; x < size.x; ++x) {
+            row[3 * x + 0] = source[4 * x + 0];
+            row[3 * x + 1] = source[4 * x + 1];
+            row[3 * x + 2] = source[4 * x + 2];
+        }
+        success = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+    return (std::fclose(file) == 0) && success;
+}
+
+bool SoftwareRenderer::getTileRange(const PhysicObject& object, IVec2& min_tile, IVec2& max_tile) const
+{
+    const Vec2  position = toScreen(object.position);
+    const float radius   = getSplatRadius() + 0.5f;
+    if (position.x + radius < 0.0f || position.y + radius < 0.0f || position.x - radius >= to<float>(size.x) || position.y - radius >= to<float>(size.y)) {
+        return false;
+    }
+    min_tile = {std::max(0, to<int32_t>(position.x - radius) / tile_size), std::max(0, to<int32_t>(position.y - radius) / tile_size)};
+    max_tile = {std::min(tiles.x - 1, to<int32_t>(position.x + radius) / tile_size), std::min(tiles.y - 1, to<int32_t>(position.y + radius) / tile_size)};
+    return true;
+}
+
+void SoftwareRenderer::binObjects()
+{
+    const auto     tile_count   = to<uint32_t>(tiles.x * tiles.y);
+    const auto     object_count = to<uint32_t>(solver.objects.size());
+    const uint32_t batch_count  = thread_pool.getBatchCount();
+    batch_counts.resize(static_cast<std::size_t>(batch_count) * tile_count);
+    thread_pool.dispatchIndexed(object_count, [&](uint32_t batch, uint32_t start, uint32_t end) {
+        uint32_t* counts = batch_counts.data() + static_cast<std::size_t>(batch) * tile_count;
+        std::fill(counts, counts + tile_count, 0u);
+        IVec2 min_tile, max_tile;
+        for (uint32_t i{start}; i < end; ++i) {
+            if (!getTileRange(solver.objects.data[i], min_tile, max_tile)) {
+                continue;
+            }
+            for (int32_t y{min_tile.y}; y <= max_tile.y; ++y) {
+                for (int32_t x{min_tile.x}; x <= max_tile.x; ++x) {
+                    ++counts[y * tiles.x + x];
+                }
+            }
+        }
+    });
+
+    // Counts become write positions, ordered by tile then by batch
+    uint32_t offset = 0;
+    for (uint32_t tile{0}; tile < tile_count; ++tile) {
+        tile_start[tile] = offset;
+        for (uint32_t batch{0}; batch < batch_count; ++batch) {
+            uint32_t& count = batch_counts[static_cast<std::size_t>(batch) * tile_count + tile];
+            const uint32_t batch_offset = offset;
+            offset += count;
+            count   = batch_offset;
+        }
+    }
+    tile_start[tile_count] = offset;
+    binned_objects.resize(offset);
+
+    thread_pool.dispatchIndexed(object_count, [&](uint32_t batch, uint32_t start, uint32_t end) {
+        uint32_t* positions = batch_counts.data() + static_cast<std::size_t>(batch) * tile_count;
+        IVec2 min_tile, max_tile;
+        for (uint32_t i{start}; i < end; ++i) {
+            if (!getTileRange(solver.objects.data[i], min_tile, max_tile)) {
+                continue;
+            }
+            for (int32_t y{min_tile.y}; y <= max_tile.y; ++y) {
+                for (int32_t x{min_tile.x}; x <= max_tile.x; ++x) {
+                    binned_objects[positions[y * tiles.x + x]++] = i;
+                }
+            }
+        }
+    });
+}
+
+void SoftwareRenderer::renderTile(int32_t tile_x, int32_t tile_y)
+{
+    const sf::IntRect clip{tile_x * tile_size, tile_y * tile_size,
+                           std::min(tile_size, to<int32_t>(size.x) - tile_x * tile_size),
+                           std::min(tile_size, to<int32_t>(size.y) - tile_y * tile_size)};
+    for (int32_t y{clip.top}; y < clip.top + clip.height; ++y) {
+        sf::Uint8* row = pixels.data() + (static_cast<std::size_t>(y) * size.x + clip.left) * 4;
+        for (int32_t x{0}; x < clip.width; ++x) {
+            row[4 * x + 0] = background_color.r;
+            row[4 * x + 1] = background_color.g;
+            row[4 * x + 2] = background_color.b;
+            row[4 * x + 3] = 255;
+        }
+    }
+
+    for (std::size_t i{0}; i < outline.size(); ++i) {
+        const TPoint& start = outline[i];
+        const TPoint& end   = outline[(i + 1) % outline.size()];
+        drawSegment(toScreen({start.x, start.y}), toScreen({end.x, end.y}), clip);
+    }
+
+    const float    radius        = getSplatRadius();
+    // Discs smaller than a pixel are drawn one pixel wide and dimmed to keep the intensity of their area
+    const float    screen_radius = getScreenRadius();
+    const float    intensity     = std::min(1.0f, (screen_radius * screen_radius) / (radius * radius));
+    const uint32_t tile          = to<uint32_t>(tile_y * tiles.x + tile_x);
+    for (uint32_t k{tile_start[tile]}; k < tile_start[tile + 1]; ++k) {
+        const PhysicObject& object   = solver.objects.data[binned_objects[k]];
+        const Vec2          position = toScreen(object.position);
+        const sf::Color     color    = object.getColor();
+        if (splat == Splat::Point) {
+            const auto x = to<int32_t>(std::floor(position.x));
+            const auto y = to<int32_t>(std::floor(position.y));
+            if (clip.contains(x, y)) {
+                blend(x, y, color, 1.0f);
+            }
+            continue;
+        }
+        // Coverage fades over one pixel at the border
+        const int32_t x_min = std::max(clip.left, to<int32_t>(std::floor(position.x - radius - 0.5f)));
+        const int32_t x_max = std::min(clip.left + clip.width - 1, to<int32_t>(std::floor(position.x + radius + 0.5f)));
+        const int32_t y_min = std::max(clip.top, to<int32_t>(std::floor(position.y - radius - 0.5f)));
+        const int32_t y_max = std::min(clip.top + clip.height - 1, to<int32_t>(std::floor(position.y + radius + 0.5f)));
+        for (int32_t y{y_min}; y <= y_max; ++y) {
+            for (int32_t x{x_min}; x <= x_max; ++x) {
+                const Vec2  to_center = Vec2{to<float>(x) + 0.5f, to<float>(y) + 0.5f} - position;
+                const float coverage  = std::clamp(radius + 0.5f - MathVec2::length(to_center), 0.0f, 1.0f);
+                if (coverage > 0.0f) {
+                    blend(x, y, color, coverage * intensity);
+                }
+            }
+        }
+    }
+}
+
+void SoftwareRenderer::drawSegment(Vec2 start, Vec2 end, const sf::IntRect& clip)
+{
+    // Liang-Barsky clipping of the segment to the tile, the tile is drawn alone
+    const Vec2 delta = end - start;
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    const float p[4] = {-delta.x, delta.x, -delta.y, delta.y};
+    const float q[4] = {start.x - to<float>(clip.left), to<float>(clip.left + clip.width) - start.x,
+                        start.y - to<float>(clip.top),  to<float>(clip.top + clip.height) - start.y};
+    for (uint32_t k{0}; k < 4; ++k) {
+        if (p[k] == 0.0f) {
+            if (q[k] < 0.0f) {
+                return;
+            }
+            continue;
+        }
+        const float t = q[k] / p[k];
+        if (p[k] < 0.0f) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+    }
+    if (t0 > t1) {
+        return;
+    }
+    const Vec2  a     = start + delta * t0;
+    const Vec2  b     = start + delta * t1;
+    const auto  steps = to<int32_t>(std::ceil(std::max(std::abs(b.x - a.x), std::abs(b.y - a.y)))) + 1;
+    const Vec2  step  = (b - a) / to<float>(std::max(steps - 1, 1));
+    for (int32_t k{0}; k < steps; ++k) {
+        const Vec2 point = a + step * to<float>(k);
+        const auto x = to<int32_t>(std::floor(point.x));
+        const auto y = to<int32_t>(std::floor(point.y));
+        if (clip.contains(x, y)) {
+            blend(x, y, outline_color, 1.0f);
+        }
+    }
+}
+
+void SoftwareRenderer::blend(int32_t x, int32_t y, sf::Color color, float alpha)
+{
+    sf::Uint8* pixel = pixels.data() + (static_cast<std::size_t>(y) * size.x + x) * 4;
+    const float a = alpha * to<float>(color.a) / 255.0f;
+    pixel[0] = static_cast<sf::Uint8>(to<float>(pixel[0]) + (to<float>(color.r) - to<float>(pixel[0])) * a);
+    pixel[1] = static_cast<sf::Uint8>(to<float>(pixel[1]) + (to<float>(color.g) - to<float>(pixel[1])) * a);
+    pixel[2] = static_cast<sf::Uint8>(to<float>(pixel[2]) + (to<float>(color.b) - to<float>(pixel[2])) * a);
+}
+
+Vec2 SoftwareRenderer::toScreen(Vec2 world_position) const
+{
+    return viewport.getScreenCoords(world_position);
+}
+
+float SoftwareRenderer::getScreenRadius() const
+{
+    return PhysicSolver::particle_radius * viewport.state.zoom;
+}
+
+float SoftwareRenderer::getSplatRadius() const
+{
+    return std::max(getScreenRadius(), 0.5f);
+}
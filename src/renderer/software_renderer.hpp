@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "physics/physics_nozzle.hpp"
+#include "engine/render/viewport_handler.hpp"
+
+
+/* CPU counterpart of Renderer for runs without GPU or display. Objects are binned by screen tile, then tiles are
+   drawn in parallel: background, geometry outline and objects in their storage order, as the window would show them.
+   The camera is a ViewportHandler, with the same zoom and focus as the window one */
+struct SoftwareRenderer
+{
+    enum class Splat
+    {
+        // One pixel per object
+        Point,
+        // Anti aliased disc of the object radius
+        Disc,
+    };
+
+    static constexpr int32_t tile_size = 64;
+
+    PhysicSolverNozzle& solver;
+    tp::ThreadPool&     thread_pool;
+
+    sf::Vector2u    size;
+    ViewportHandler viewport;
+    Splat           splat            = Splat::Disc;
+    sf::Color       background_color = sf::Color::Black;
+    sf::Color       outline_color    = {70, 70, 70};
+
+    // RGBA, rows from top to bottom
+    std::vector<sf::Uint8> pixels;
+
+    SoftwareRenderer(PhysicSolverNozzle& solver_, tp::ThreadPool& tp, sf::Vector2u size_);
+
+    void setZoom(float zoom);
+
+    void setFocus(Vec2 focus);
+
+    void render();
+
+    // PPM when the path ends with .ppm, any format SFML can write otherwise
+    bool save(const std::string& path) const;
+
+private:
+    IVec2                 tiles;
+    std::vector<TPoint>   outline;
+    // Objects of each tile, counted then scattered per batch of objects to keep their order
+    std::vector<uint32_t> batch_counts;
+    std::vector<uint32_t> tile_start;
+    std::vector<uint32_t> binned_objects;
+
+    // Screen position and radius of an object, returns false when it doesn't touch the screen
+    bool getTileRange(const PhysicObject& object, IVec2& min_tile, IVec2& max_tile) const;
+
+    void binObjects();
+
+    void renderTile(int32_t tile_x, int32_t tile_y);
+
+    void drawSegment(Vec2 start, Vec2 end, const sf::IntRect& clip);
+
+    void blend(int32_t x, int32_t y, sf::Color color, float alpha);
+
+    Vec2 toScreen(Vec2 world_position) const;
+
+    float getScreenRadius() const;
+
+    // Radius of the drawn discs, at least half a pixel
+    float getSplatRadius() const;
+};
@@ -130,18 +130,33 @@ struct ThreadPool
 
     template<typename TCallback>
     void dispatch(uint32_t element_count, TCallback&& callback)
+    {
+        dispatchIndexed(element_count, [&callback](uint32_t, uint32_t start, uint32_t end){
+            callback(start, end);
+        });
+    }
+
+    // Number of batches created by dispatch, the last one being the remainder processed by the calling thread
+    [[nodiscard]]
+    uint32_t getBatchCount() const
+    {
+        return m_thread_count + 1;
+    }
+
+    /* Same as dispatch but also provides the batch index to allow lock free per batch accumulators.
+       Every batch index below getBatchCount is called exactly once, the remainder one with an empty range when the
+       count is a multiple of the threads count, so per batch buffers can be reset by the callback itself */
+    template<typename TCallback>
+    void dispatchIndexed(uint32_t element_count, TCallback&& callback)
     {
         const uint32_t batch_size = element_count / m_thread_count;
         for (uint32_t i{0}; i < m_thread_count; ++i) {
             const uint32_t start = batch_size * i;
             const uint32_t end   = start + batch_size;
-            addTask([start, end, &callback](){ callback(start, end); });
+            addTask([i, start, end, &callback](){ callback(i, start, end); });
         }
 
-        if (batch_size * m_thread_count < element_count) {
-            const uint32_t start = batch_size * m_thread_count;
-            callback(start, element_count);
-        }
+        callback(m_thread_count, batch_size * m_thread_count, element_count);
 
         waitForCompletion();
     }
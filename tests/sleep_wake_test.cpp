@@ -0,0 +1,122 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "physics/physics.hpp"
+
+
+/* A resting lattice falls asleep, then a fast slab is fired into it. Objects of the lattice are spaced out so the
+   disturbance travels through it as a front, one collision at a time. The blocks reached by the front have to wake
+   up, and the front has to progress as in a run where sleeping is disabled */
+struct FrontSample
+{
+    // Lattice objects pushed away from their rest position, the furthest rest position among them and how far
+    // the lattice moved on average
+    uint32_t moved_count = 0;
+    float    front_x     = 0.0f;
+    float    mean_shift  = 0.0f;
+};
+
+// Frames after the slab is created at which the front is sampled, it is still inside the lattice at the last one
+constexpr uint32_t sample_frames[] = {40, 80};
+constexpr uint32_t samples_count   = sizeof(sample_frames) / sizeof(sample_frames[0]);
+
+struct RunResult
+{
+    uint32_t    asleep_before_impact = 0;
+    bool        front_woken          = false;
+    FrontSample samples[samples_count];
+};
+
+
+static RunResult run(bool sleep_enabled)
+{
+    const IVec2 world_size{200, 60};
+    tp::ThreadPool thread_pool(2);
+    PhysicSolver   solver{world_size, thread_pool};
+    solver.gravity       = {0.0f, 0.0f};
+    solver.sleep_enabled = sleep_enabled;
+
+    const float lattice_start = 60.5f;
+    const float spacing       = 1.5f;
+    std::vector<uint64_t> lattice;
+    std::vector<Vec2>     rest_positions;
+    for (float x{lattice_start}; x < 196.0f; x += spacing) {
+        for (float y{3.5f}; y < 57.0f; y += spacing) {
+            lattice.push_back(solver.createObject({x, y}));
+            rest_positions.push_back({x, y});
+        }
+    }
+
+    RunResult result;
+    const float dt = 1.0f / 60.0f;
+    for (uint32_t i{20}; i--;) {
+        solver.update(dt);
+    }
+    result.asleep_before_impact = solver.getSleepingBlocksCount();
+
+    // Slab moving toward the lattice
+    for (int32_t x{10}; x < 40; ++x) {
+        for (int32_t y{3}; y < 57; ++y) {
+            const uint64_t id = solver.createObject({to<float>(x) + 0.5f, to<float>(y) + 0.5f});
+            solver.objects[id].last_position.x -= 0.1f;
+        }
+    }
+    // Block of the lattice first reached by the front
+    const uint32_t front_block = solver.getBlockIndex({lattice_start, to<float>(world_size.y) * 0.5f});
+    uint32_t frame = 0;
+    for (uint32_t s{0}; s < samples_count; ++s) {
+        for (; frame < sample_frames[s]; ++frame) {
+            solver.update(dt);
+            result.front_woken = result.front_woken || !solver.block_asleep[front_block];
+        }
+        FrontSample& sample = result.samples[s];
+        for (std::size_t k{0}; k < lattice.size(); ++k) {
+            const Vec2 position = solver.objects[lattice[k]].position;
+            sample.mean_shift += position.x - rest_positions[k].x;
+            if (MathVec2::length(position - rest_positions[k]) > 0.2f) {
+                ++sample.moved_count;
+                sample.front_x = std::max(sample.front_x, rest_positions[k].x);
+            }
+        }
+        sample.mean_shift /= to<float>(lattice.size());
+    }
+    return result;
+}
+
+
+static bool check(bool condition, const char* description)
+{
+    printf("%s: %s\n", condition ? "ok  " : "FAIL", description);
+    return condition;
+}
+
+
+int main()
+{
+    const RunResult awake    = run(false);
+    const RunResult sleeping = run(true);
+    printf("%u blocks asleep before impact\n", sleeping.asleep_before_impact);
+    for (uint32_t s{0}; s < samples_count; ++s) {
+        const FrontSample& a = awake.samples[s];
+        const FrontSample& b = sleeping.samples[s];
+        printf("frame %u, sleep disabled: moved %u, front x %.1f, mean shift %.3f\n", sample_frames[s], a.moved_count, a.front_x, a.mean_shift);
+        printf("frame %u, sleep enabled:  moved %u, front x %.1f, mean shift %.3f\n", sample_frames[s], b.moved_count, b.front_x, b.mean_shift);
+    }
+
+    bool success = true;
+    success = check(sleeping.asleep_before_impact > 0, "the resting lattice falls asleep") && success;
+    success = check(sleeping.front_woken, "the shock front wakes the lattice up") && success;
+    const FrontSample& last = awake.samples[samples_count - 1];
+    success = check(awake.samples[0].moved_count > 0 && last.front_x < 190.0f, "the front is inside the lattice when sampled") && success;
+    // Contacts are chaotic, the front is compared in bulk rather than object by object
+    for (uint32_t s{0}; s < samples_count; ++s) {
+        const FrontSample& a = awake.samples[s];
+        const FrontSample& b = sleeping.samples[s];
+        const float moved_ratio = to<float>(b.moved_count) / to<float>(std::max(a.moved_count, 1u));
+        const float shift_ratio = b.mean_shift / std::max(a.mean_shift, 1e-6f);
+        success = check(std::abs(moved_ratio - 1.0f) < 0.05f, "as many objects are pushed as without sleeping") && success;
+        success = check(std::abs(b.front_x - a.front_x) < 3.0f, "the front gets as far as without sleeping") && success;
+        success = check(std::abs(shift_ratio - 1.0f) < 0.05f, "the lattice moves as much as without sleeping") && success;
+    }
+    return success ? 0 : 1;
+}